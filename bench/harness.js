@@ -0,0 +1,124 @@
+// Shared plumbing for the benchmarks: connected port pairs, timing and stats
+const midi = require('../midi.js')
+
+let pairCount = 0
+
+/**
+ * Open an output connected to an input over the given api, by opening a
+ * virtual port on the input and finding it from the output side. Returns
+ * undefined when the api can't make virtual ports on this platform.
+ */
+function openPair(api) {
+  const name = `node-midi bench ${process.pid} ${pairCount++}`
+
+  const input = new midi.Input(api)
+  const output = new midi.Output(api)
+  try {
+    input.openVirtualPort(name)
+  } catch (e) {
+    input.destroy()
+    output.destroy()
+    return undefined
+  }
+
+  for (let port = 0; port < output.getPortCount(); ++port) {
+    if (output.getPortName(port).includes(name)) {
+      output.openPort(port)
+      return { input, output }
+    }
+  }
+
+  input.destroy()
+  output.destroy()
+  return undefined
+}
+
+function closePair(pair) {
+  pair.input.removeAllListeners()
+  pair.input.destroy()
+  pair.output.destroy()
+}
+
+function now() {
+  return process.hrtime.bigint()
+}
+
+function elapsedSeconds(start, end = now()) {
+  return Number(end - start) / 1e9
+}
+
+/** Nearest-rank percentiles of a list of samples, in the samples' unit */
+function percentiles(samples) {
+  if (samples.length === 0) {
+    return undefined
+  }
+
+  const sorted = Float64Array.from(samples).sort()
+  const at = (p) => sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)]
+  let sum = 0
+  for (const sample of sorted) {
+    sum += sample
+  }
+
+  return {
+    min: sorted[0],
+    mean: sum / sorted.length,
+    p50: at(0.5),
+    p90: at(0.9),
+    p99: at(0.99),
+    p999: at(0.999),
+    max: sorted[sorted.length - 1],
+  }
+}
+
+/**
+ * Resolve once count messages have arrived through subscribe(), or reject
+ * when nothing has arrived for idleMs. subscribe is given a handler to call
+ * per message and returns a function which unsubscribes it.
+ */
+function receive(subscribe, count, idleMs = 2000) {
+  return new Promise((resolve, reject) => {
+    let received = 0
+    let timer
+    const arm = () => {
+      clearTimeout(timer)
+      timer = setTimeout(() => {
+        unsubscribe()
+        reject(new Error(`Timed out after receiving ${received} of ${count} messages`))
+      }, idleMs)
+    }
+    const unsubscribe = subscribe(() => {
+      if (++received === count) {
+        clearTimeout(timer)
+        unsubscribe()
+        resolve(now())
+      } else if ((received & 0xff) === 0) {
+        arm()
+      }
+    })
+    arm()
+  })
+}
+
+function onMessage(input) {
+  return (handler) => {
+    input.on('message', handler)
+    return () => input.off('message', handler)
+  }
+}
+
+/** Let the event loop run, so sends don't starve delivery */
+function yieldLoop() {
+  return new Promise((resolve) => setImmediate(resolve))
+}
+
+module.exports = {
+  openPair,
+  closePair,
+  now,
+  elapsedSeconds,
+  percentiles,
+  receive,
+  onMessage,
+  yieldLoop,
+}
@@ -0,0 +1,254 @@
+#!/usr/bin/env node
+// Throughput and latency benchmarks, run with `npm run bench -- [options]`
+//
+//   --api <list>     comma separated apis to run over, default the in-process
+//                    loopback and the platform's native api when it has
+//                    virtual ports (alsa or core)
+//   --only <list>    comma separated benchmark names to run
+//   --count <n>      messages per throughput run, default 100000
+//   --samples <n>    round trips per latency run, default 2000
+//   --out <path>     write the results to a file instead of stdout
+//
+// Results are printed as JSON, with a summary table on stderr.
+const fs = require('fs')
+const os = require('os')
+const midi = require('../midi.js')
+const {
+  openPair, closePair, now, elapsedSeconds, percentiles, receive, onMessage, yieldLoop,
+} = require('./harness')
+
+const NOTE_ON = [0x90, 60, 100]
+const BATCH_SIZES = [1, 16, 256, 4096]
+const SYSEX_SIZES = [16, 256, 4096, 65536]
+
+function parseArgs(argv) {
+  const native = { linux: midi.Api.ALSA, darwin: midi.Api.CORE }[process.platform]
+  const options = {
+    apis: [midi.Api.LOOPBACK, ...(native ? [native] : [])],
+    only: undefined,
+    count: 100000,
+    samples: 2000,
+    out: undefined,
+  }
+
+  for (let i = 0; i < argv.length; ++i) {
+    const value = argv[i + 1]
+    switch (argv[i]) {
+      case '--api':
+        options.apis = value.split(',')
+        break
+      case '--only':
+        options.only = value.split(',')
+        break
+      case '--count':
+        options.count = parseInt(value, 10)
+        break
+      case '--samples':
+        options.samples = parseInt(value, 10)
+        break
+      case '--out':
+        options.out = value
+        break
+      default:
+        throw new Error(`Unknown option ${argv[i]}`)
+    }
+    ++i
+  }
+
+  return options
+}
+
+function sysex(size) {
+  const message = Buffer.alloc(size, 0x55)
+  message[0] = 0xf0
+  message[1] = 0x7d
+  message[size - 1] = 0xf7
+  return message
+}
+
+/** Time a loop of sendMessage calls, delivery is only waited for to drain */
+async function outputSend(pair, { count }) {
+  const message = Buffer.from(NOTE_ON)
+  const done = receive(onMessage(pair.input), count)
+
+  const start = now()
+  for (let i = 0; i < count; ++i) {
+    pair.output.sendMessage(message)
+    if ((i & 0x3ff) === 0x3ff) {
+      await yieldLoop()
+    }
+  }
+  const sent = elapsedSeconds(start)
+  await done
+
+  return { count, seconds: sent, messagesPerSecond: count / sent }
+}
+
+/** Time from the first send until the last 'message' event, in batches */
+async function inputDelivery(pair, { count, batch }) {
+  const message = Buffer.from(NOTE_ON)
+  const done = receive(onMessage(pair.input), count)
+
+  const start = now()
+  for (let sent = 0; sent < count;) {
+    for (const end = Math.min(count, sent + batch); sent < end; ++sent) {
+      pair.output.sendMessage(message)
+    }
+    await yieldLoop()
+  }
+  const seconds = elapsedSeconds(start, await done)
+
+  return { count, batch, seconds, messagesPerSecond: count / seconds }
+}
+
+/** One message in flight at a time, timed from send to 'message' event */
+async function roundTrip(pair, { samples, message }) {
+  pair.input.ignoreTypes(false, true, true)
+
+  const latencies = []
+  for (let i = 0; i < samples; ++i) {
+    const start = now()
+    const arrived = receive(onMessage(pair.input), 1)
+    pair.output.sendMessage(message)
+    latencies.push(elapsedSeconds(start, await arrived) * 1e6)
+  }
+
+  return { samples, bytes: message.length, latencyUs: percentiles(latencies) }
+}
+
+/** Throughput of sysex messages of one size, in messages and bytes */
+async function sysexThroughput(pair, { count, size }) {
+  pair.input.ignoreTypes(false, true, true)
+  pair.input.setBufferSize(Math.max(1024, size), 4)
+
+  // Keep the total data roughly constant across sizes
+  count = Math.max(100, Math.min(count, Math.floor((64 * 1024 * 1024) / size)))
+  const message = sysex(size)
+  const done = receive(onMessage(pair.input), count)
+
+  const start = now()
+  for (let i = 0; i < count; ++i) {
+    pair.output.sendMessage(message)
+    if ((i & 0x3f) === 0x3f) {
+      await yieldLoop()
+    }
+  }
+  const seconds = elapsedSeconds(start, await done)
+
+  return { count, size, seconds, messagesPerSecond: count / seconds, bytesPerSecond: (count * size) / seconds }
+}
+
+/** Throughput through createWriteStream() and createReadStream() */
+async function streams(pair, { count }) {
+  const writable = midi.createWriteStream(pair.output)
+  const readable = midi.createReadStream(pair.input)
+  const message = Buffer.from(NOTE_ON)
+
+  const done = receive((handler) => {
+    readable.on('data', handler)
+    return () => readable.removeListener('data', handler)
+  }, count)
+
+  const start = now()
+  for (let i = 0; i < count; ++i) {
+    writable.write(message)
+    if ((i & 0x3ff) === 0x3ff) {
+      await yieldLoop()
+    }
+  }
+  const seconds = elapsedSeconds(start, await done)
+  writable.end()
+
+  return { count, seconds, messagesPerSecond: count / seconds }
+}
+
+function benchmarks(options) {
+  return [
+    { name: 'output-send', run: (pair) => outputSend(pair, options) },
+    ...BATCH_SIZES.map((batch) => ({
+      name: `input-delivery-batch-${batch}`,
+      run: (pair) => inputDelivery(pair, { count: options.count, batch }),
+    })),
+    {
+      name: 'round-trip',
+      run: (pair) => roundTrip(pair, { samples: options.samples, message: Buffer.from(NOTE_ON) }),
+    },
+    ...SYSEX_SIZES.map((size) => ({
+      name: `sysex-${size}`,
+      run: (pair) => sysexThroughput(pair, { count: options.count, size }),
+    })),
+    ...SYSEX_SIZES.map((size) => ({
+      name: `sysex-round-trip-${size}`,
+      run: (pair) => roundTrip(pair, { samples: Math.min(options.samples, 500), message: sysex(size) }),
+    })),
+    { name: 'streams', run: (pair) => streams(pair, options) },
+  ]
+}
+
+function summarise(result) {
+  if (result.error) {
+    return `error: ${result.error}`
+  }
+  if (result.latencyUs) {
+    const { p50, p99, max } = result.latencyUs
+    return `p50 ${p50.toFixed(1)}us  p99 ${p99.toFixed(1)}us  max ${max.toFixed(1)}us`
+  }
+  return `${Math.round(result.messagesPerSecond).toLocaleString()} msg/s`
+}
+
+async function main() {
+  const options = parseArgs(process.argv.slice(2))
+
+  const results = []
+  for (const api of options.apis) {
+    for (const benchmark of benchmarks(options)) {
+      if (options.only && !options.only.includes(benchmark.name)) {
+        continue
+      }
+
+      // A fresh pair per benchmark, so one can't leave a backlog for the next
+      const pair = openPair(api)
+      if (!pair) {
+        process.stderr.write(`${api}: no virtual ports, skipping\n`)
+        break
+      }
+
+      let result
+      try {
+        result = await benchmark.run(pair)
+      } catch (e) {
+        result = { error: e.message }
+      } finally {
+        closePair(pair)
+      }
+
+      results.push({ api, name: benchmark.name, ...result })
+      process.stderr.write(`${api.padEnd(9)} ${benchmark.name.padEnd(26)} ${summarise(result)}\n`)
+    }
+  }
+
+  const report = JSON.stringify({
+    date: new Date().toISOString(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpu: os.cpus()[0] ? os.cpus()[0].model : undefined,
+    options: { count: options.count, samples: options.samples },
+    results,
+  }, null, 2)
+
+  if (options.out) {
+    fs.writeFileSync(options.out, report + '\n')
+  } else {
+    process.stdout.write(report + '\n')
+  }
+
+  if (results.some((result) => result.error)) {
+    process.exitCode = 1
+  }
+}
+
+main().catch((e) => {
+  process.stderr.write(`${e.stack}\n`)
+  process.exitCode = 1
+})
@@ -11,6 +11,10 @@
       'msvs_settings': {
         'VCCLCompilerTool': { 'ExceptionHandling': 1 },
       },
+      'defines': [
+        '__RTMIDI_LOOPBACK__',
+        '__NODE_MIDI_PROBES__'
+      ],
       'include_dirs': [
         '<!(node -p "require(\'node-addon-api\').include_dir")',
         'src',
@@ -18,8 +22,27 @@
       ],
       'sources': [
         'vendor/rtmidi/RtMidi.cpp',
+        'src/capture.cpp',
+        'src/chords.cpp',
+        'src/coalescer.cpp',
+        'src/hub.cpp',
         'src/input.cpp',
+        'src/lanes.cpp',
         'src/output.cpp',
+        'src/params.cpp',
+        'src/ports.cpp',
+        'src/probes.cpp',
+        'src/pattern.cpp',
+        'src/recorder.cpp',
+        'src/sequencer.cpp',
+        'src/splitter.cpp',
+        'src/stats.cpp',
+        'src/subscriber.cpp',
+        'src/sysex.cpp',
+        'src/thinning.cpp',
+        'src/timer.cpp',
+        'src/transform.cpp',
+        'src/ump.cpp',
         'src/midi.cpp'
       ],
       'conditions': [
@@ -29,12 +52,15 @@
               '-fno-exceptions'
             ],
             'defines': [
-              '__LINUX_ALSA__'
+              '__LINUX_ALSA__',
+              '__RTMIDI_SHM__',
+              '__RTMIDI_RTP__'
             ],
             'link_settings': {
               'libraries': [
                 '-lasound',
                 '-lpthread',
+                '-lrt',
               ]
             }
           }
@@ -42,7 +68,9 @@
         ['OS=="mac"',
           {
             'defines': [
-              '__MACOSX_CORE__'
+              '__MACOSX_CORE__',
+              '__RTMIDI_SHM__',
+              '__RTMIDI_RTP__'
             ],
             'xcode_settings': {
               'GCC_ENABLE_CPP_EXCEPTIONS': 'YES'
@@ -0,0 +1,172 @@
+// Reader for the flight recorder ring file, see src/recorder.h for the layout
+const fs = require('fs')
+
+const HEADER_SIZE = 64
+const RECORD_SIZE = 16
+const MAGIC = 'NMFR'
+const VERSION = 1
+
+const Directions = ['in', 'out', 'open-in', 'open-out']
+
+function toNanoseconds(time) {
+  if (time === undefined || time === null) {
+    return undefined
+  }
+  if (time instanceof Date) {
+    time = time.getTime()
+  }
+  return BigInt(Math.round(time * 1e6))
+}
+
+/**
+ * Read the records in a flight recorder file, optionally limited to a
+ * window of wall clock time given as Dates or milliseconds since the epoch.
+ * Returns the names of the ports which were opened while recording, and the
+ * messages in the order they were recorded.
+ */
+function read(path, { since, until } = {}) {
+  const file = fs.readFileSync(path)
+  if (file.length < HEADER_SIZE || file.toString('latin1', 0, 4) !== MAGIC) {
+    throw new Error('Not a flight recorder file')
+  }
+  if (file.readUInt32LE(4) !== VERSION) {
+    throw new Error('Unsupported flight recorder version')
+  }
+
+  const capacity = file.readBigUInt64LE(8)
+  const head = file.readBigUInt64LE(16)
+  let offset = file.readBigUInt64LE(24)
+  const ring = file.subarray(HEADER_SIZE, HEADER_SIZE + Number(capacity))
+
+  // Records may wrap around the end of the ring
+  const slice = (start, length) => {
+    const position = Number(start % capacity)
+    if (position + length <= ring.length) {
+      return ring.subarray(position, position + length)
+    }
+    return Buffer.concat([ring.subarray(position), ring.subarray(0, position + length - ring.length)])
+  }
+
+  const from = toNanoseconds(since)
+  const to = toNanoseconds(until)
+
+  const ports = {}
+  const events = []
+  while (offset + BigInt(RECORD_SIZE) <= head) {
+    const record = slice(offset, RECORD_SIZE)
+    const time = record.readBigUInt64LE(0)
+    const length = record.readUInt32LE(8)
+    const port = record.readUInt16LE(12)
+    const direction = Directions[record[14]]
+
+    if (offset + BigInt(RECORD_SIZE + length) > head) {
+      break
+    }
+    const message = slice(offset + BigInt(RECORD_SIZE), length)
+    offset += BigInt((RECORD_SIZE + length + 7) & ~7)
+
+    if (direction === 'open-in' || direction === 'open-out') {
+      // Port names are kept regardless of the window, to label its messages
+      ports[port] = { name: message.toString('utf8'), direction: direction.slice(5) }
+      continue
+    }
+
+    if ((from !== undefined && time < from) || (to !== undefined && time > to)) {
+      continue
+    }
+
+    events.push({
+      time: Number(time / 1000n) / 1000,
+      port,
+      direction,
+      message: Array.from(message),
+    })
+  }
+
+  return { ports, events }
+}
+
+/** Format a recording as JSON, with ISO timestamps for readability */
+function toJson(recording) {
+  return JSON.stringify({
+    ports: recording.ports,
+    events: recording.events.map((event) => ({
+      ...event,
+      date: new Date(event.time).toISOString(),
+    })),
+  }, null, 2)
+}
+
+function variableLength(value) {
+  const bytes = [value & 0x7f]
+  while ((value >>= 7) > 0) {
+    bytes.unshift((value & 0x7f) | 0x80)
+  }
+  return bytes
+}
+
+function track(data) {
+  const header = Buffer.alloc(8)
+  header.write('MTrk', 0, 'latin1')
+  header.writeUInt32BE(data.length, 4)
+  return Buffer.concat([header, Buffer.from(data)])
+}
+
+/**
+ * Convert a recording to a format 1 Standard MIDI File, with a track for
+ * each port and direction. Ticks are milliseconds from the first event.
+ * System common and real-time messages can't be stored in a file, so are
+ * left out.
+ */
+function toSmf(recording) {
+  const start = recording.events.length > 0 ? recording.events[0].time : 0
+
+  const tracks = new Map()
+  for (const event of recording.events) {
+    const status = event.message[0]
+    if (status === undefined || (status >= 0xf1 && status <= 0xff) || status < 0x80) {
+      continue
+    }
+
+    const key = `${event.port}:${event.direction}`
+    if (!tracks.has(key)) {
+      const port = recording.ports[event.port]
+      const name = Buffer.from(`${event.direction} ${event.port}${port ? ` ${port.name}` : ''}`)
+      tracks.set(key, { tick: 0, data: [0x00, 0xff, 0x03, ...variableLength(name.length), ...name] })
+    }
+
+    const current = tracks.get(key)
+    const tick = Math.max(current.tick, Math.round(event.time - start))
+    current.data.push(...variableLength(tick - current.tick))
+    current.tick = tick
+
+    if (status === 0xf0) {
+      const body = event.message.slice(1)
+      current.data.push(0xf0, ...variableLength(body.length), ...body)
+    } else {
+      current.data.push(...event.message)
+    }
+  }
+
+  // 1000 ticks per quarter note at 60 bpm makes a tick one millisecond
+  const conductor = [0x00, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40, 0x00, 0xff, 0x2f, 0x00]
+
+  const header = Buffer.alloc(14)
+  header.write('MThd', 0, 'latin1')
+  header.writeUInt32BE(6, 4)
+  header.writeUInt16BE(1, 8)
+  header.writeUInt16BE(tracks.size + 1, 10)
+  header.writeUInt16BE(1000, 12)
+
+  return Buffer.concat([
+    header,
+    track(conductor),
+    ...Array.from(tracks.values(), (current) => track([...current.data, 0x00, 0xff, 0x2f, 0x00])),
+  ])
+}
+
+module.exports = {
+  read,
+  toJson,
+  toSmf,
+}
@@ -0,0 +1,295 @@
+// Compiler for the per-event rules run by Input.setTransform(), see
+// src/transform.h for the machine the rules are compiled for
+
+const Op = Object.freeze({
+  END: 0,
+  LOADI: 1,
+  MOV: 2,
+  ADD: 3,
+  SUB: 4,
+  MUL: 5,
+  DIV: 6,
+  AND: 7,
+  OR: 8,
+  SHL: 9,
+  SHR: 10,
+  MIN: 11,
+  MAX: 12,
+  ADDI: 13,
+  LOOKUP: 14,
+  JUMP: 15,
+  JEQ: 16,
+  JNE: 17,
+  JLT: 18,
+  JGT: 19,
+  FORWARD: 20,
+  EMIT: 21,
+})
+
+const Types = Object.freeze({
+  noteoff: 0x80,
+  noteon: 0x90,
+  polypressure: 0xa0,
+  cc: 0xb0,
+  program: 0xc0,
+  pressure: 0xd0,
+  pitchbend: 0xe0,
+  mtc: 0xf1,
+  songposition: 0xf2,
+  songselect: 0xf3,
+  tunerequest: 0xf6,
+  clock: 0xf8,
+  start: 0xfa,
+  continue: 0xfb,
+  stop: 0xfc,
+  activesensing: 0xfe,
+  reset: 0xff,
+})
+
+// Registers loaded with the incoming message
+const Fields = Object.freeze({
+  status: 0,
+  data1: 1,
+  note: 1,
+  controller: 1,
+  data2: 2,
+  velocity: 2,
+  value: 2,
+  length: 3,
+  channel: 4,
+  type: 5,
+})
+
+// Registers the compiler uses for its own work
+const SCRATCH = 6
+const OPERAND = 7
+const OUT = 8
+
+function immediate(value) {
+  if (!Number.isInteger(value) || value < -32768 || value > 32767) {
+    throw new RangeError(`${value} does not fit in an instruction`)
+  }
+  return value
+}
+
+function encode(op, a = 0, b = 0, imm = 0) {
+  return (op | (a << 8) | (b << 12) | ((immediate(imm) & 0xffff) << 16)) >>> 0
+}
+
+function typeStatus(type) {
+  const status = typeof type === 'string' ? Types[type] : type
+  if (!Number.isInteger(status) || status < 0x80 || status > 0xff || (status < 0xf0 && (status & 0x0f))) {
+    throw new RangeError(`Unknown message type ${type}`)
+  }
+  return status
+}
+
+function messageLength(status) {
+  if (status < 0xf0) {
+    return (status & 0xf0) === 0xc0 || (status & 0xf0) === 0xd0 ? 2 : 3
+  }
+  if (status === 0xf2) {
+    return 3
+  }
+  if (status === 0xf1 || status === 0xf3) {
+    return 2
+  }
+  if (status === 0xf0 || status === 0xf7) {
+    throw new RangeError('Rules cannot send sysex')
+  }
+  return 1
+}
+
+function field(name) {
+  if (!(name in Fields)) {
+    throw new RangeError(`Unknown message field ${name}`)
+  }
+  return Fields[name]
+}
+
+class Compiler {
+  constructor() {
+    this.code = []
+    this.tables = []
+    this.outputs = []
+  }
+
+  add(op, a, b, imm) {
+    this.code.push(encode(op, a, b, imm))
+    return this.code.length - 1
+  }
+
+  // Points the jump at index to the next instruction to be added
+  land(index) {
+    const word = this.code[index]
+    this.code[index] = encode(word & 0xff, (word >> 8) & 0x0f, (word >> 12) & 0x0f, this.code.length - index)
+  }
+
+  target(to) {
+    if (to === undefined || to === null || to === true) {
+      return 0
+    }
+    let index = this.outputs.indexOf(to)
+    if (index === -1) {
+      index = this.outputs.push(to) - 1
+    }
+    return index + 1
+  }
+
+  // Adds jumps which are taken when the register doesn't match, returning them
+  match(register, condition) {
+    if (Array.isArray(condition)) {
+      const [min, max] = condition
+      this.add(Op.LOADI, SCRATCH, 0, min)
+      const low = this.add(Op.JLT, register, SCRATCH, 1)
+      this.add(Op.LOADI, SCRATCH, 0, max)
+      return [low, this.add(Op.JGT, register, SCRATCH, 1)]
+    }
+    this.add(Op.LOADI, SCRATCH, 0, condition)
+    return [this.add(Op.JNE, register, SCRATCH, 1)]
+  }
+
+  // Leaves the value of expr in register, applying map, scale, mul, div,
+  // add, min and max in that order
+  value(register, expr) {
+    if (typeof expr === 'number') {
+      this.add(Op.LOADI, register, 0, expr)
+      return
+    }
+    if (typeof expr === 'string') {
+      this.add(Op.MOV, register, field(expr))
+      return
+    }
+
+    const { from, map, scale, mul, div, add, min, max } = expr
+    this.add(Op.MOV, register, field(from))
+    if (map !== undefined) {
+      if (!map.length) {
+        throw new RangeError('A map must not be empty')
+      }
+      this.tables.push(Int32Array.from(map))
+      this.add(Op.LOOKUP, register, 0, this.tables.length - 1)
+    }
+    if (scale !== undefined) {
+      const [inMin, inMax, outMin, outMax] = scale
+      if (inMax === inMin) {
+        throw new RangeError('A scale needs an input range')
+      }
+      this.add(Op.ADDI, register, 0, -inMin)
+      this.add(Op.LOADI, OPERAND, 0, outMax - outMin)
+      this.add(Op.MUL, register, OPERAND)
+      this.add(Op.LOADI, OPERAND, 0, inMax - inMin)
+      this.add(Op.DIV, register, OPERAND)
+      this.add(Op.ADDI, register, 0, outMin)
+    }
+    if (mul !== undefined) {
+      this.add(Op.LOADI, OPERAND, 0, mul)
+      this.add(Op.MUL, register, OPERAND)
+    }
+    if (div !== undefined) {
+      if (div === 0) {
+        throw new RangeError('Cannot divide by zero')
+      }
+      this.add(Op.LOADI, OPERAND, 0, div)
+      this.add(Op.DIV, register, OPERAND)
+    }
+    if (add !== undefined) {
+      this.add(Op.ADDI, register, 0, add)
+    }
+    if (min !== undefined) {
+      this.add(Op.LOADI, OPERAND, 0, min)
+      this.add(Op.MAX, register, OPERAND)
+    }
+    if (max !== undefined) {
+      this.add(Op.LOADI, OPERAND, 0, max)
+      this.add(Op.MIN, register, OPERAND)
+    }
+  }
+
+  send(message) {
+    const { status, type, channel = 'channel', to } = message
+    const data1 = message.data1 ?? message.note ?? message.controller ?? 'data1'
+    const data2 = message.data2 ?? message.velocity ?? message.value ?? 'data2'
+
+    let length
+    if (status !== undefined) {
+      this.add(Op.LOADI, OUT, 0, status)
+      length = messageLength(status)
+    } else {
+      const base = typeStatus(type)
+      length = messageLength(base)
+      this.add(Op.LOADI, OUT, 0, base)
+      if (base < 0xf0) {
+        this.value(SCRATCH, channel)
+        this.add(Op.LOADI, OPERAND, 0, 0x0f)
+        this.add(Op.AND, SCRATCH, OPERAND)
+        this.add(Op.OR, OUT, SCRATCH)
+      }
+    }
+
+    if (length > 1) {
+      this.value(OUT + 1, data1)
+    }
+    if (length > 2) {
+      this.value(OUT + 2, data2)
+    }
+    this.add(Op.EMIT, OUT, length, this.target(to))
+  }
+
+  rule(rule) {
+    const { match = {}, forward, send } = rule
+
+    const misses = []
+    for (const [name, condition] of Object.entries(match)) {
+      if (name === 'type') {
+        misses.push(...this.match(Fields.type, typeStatus(condition)))
+      } else {
+        misses.push(...this.match(field(name), condition))
+      }
+    }
+
+    if (forward !== undefined && forward !== false) {
+      for (const to of [].concat(forward)) {
+        this.add(Op.FORWARD, 0, 0, this.target(to))
+      }
+    }
+    if (send !== undefined) {
+      for (const message of [].concat(send)) {
+        this.send(message)
+      }
+    }
+    if (!rule.continue) {
+      this.add(Op.END)
+    }
+
+    for (const miss of misses) {
+      this.land(miss)
+    }
+  }
+}
+
+/**
+ * Compile a list of rules into a program for Input.setTransform(). Each
+ * incoming message is checked against the rules in order, and the first
+ * rule it matches decides what happens to it; anything not forwarded to JS
+ * never leaves the input thread.
+ */
+function compile(rules) {
+  const compiler = new Compiler()
+  for (const rule of rules) {
+    compiler.rule(rule)
+  }
+
+  return {
+    code: Uint32Array.from(compiler.code),
+    tables: compiler.tables,
+    outputs: compiler.outputs,
+  }
+}
+
+module.exports = {
+  Op,
+  Types,
+  encode,
+  compile,
+}
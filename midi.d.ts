@@ -9,9 +9,124 @@ import { EventEmitter } from 'events';
  */
 export type MidiMessage = number[];
 export type MidiCallback = (deltaTime: number, message: MidiMessage) => void;
+export type UmpCallback = (deltaTime: number, words: Uint32Array) => void;
+export interface MidiParameter {
+    /** Zero based MIDI channel */
+    channel: number;
+    /** Controller number for 14-bit CCs, parameter number for RPN/NRPN */
+    param: number;
+    /** 14-bit value */
+    value: number;
+}
+export type ParameterCallback = (deltaTime: number, parameter: MidiParameter) => void;
+export interface MidiChord {
+    channel: number;
+    /** False for a chord of note offs */
+    on: boolean;
+    /** In the order they arrived */
+    notes: number[];
+    velocities: number[];
+}
+export type ChordCallback = (deltaTime: number, chord: MidiChord) => void;
+export interface ThinningRule {
+    /** Zero based, every channel when left out */
+    channel?: number;
+    /**
+     * A CC number, 'pitchbend' or 'pressure'. When left out, every CC but
+     * bank select, data entry, the parameter numbers and channel mode.
+     */
+    controller?: number | 'pitchbend' | 'pressure';
+    /** Drop changes smaller than this */
+    deadband?: number;
+    /** Drop changes of direction smaller than this */
+    hysteresis?: number;
+    /** Most updates per second, the last value held back is sent when the interval is up */
+    rate?: number;
+}
+export interface RequestOptions {
+    /** Input to wait for the reply on */
+    input: Input;
+    /**
+     * Prefix the reply must start with, where null matches any byte. Defaults
+     * to the request's F0 and manufacturer ID, or to waiting for an ACK alone
+     * when handshake is set.
+     */
+    match?: (number | null)[];
+    /** Time to wait for the reply, restarted by ACK and NAK. Defaults to 1000 */
+    timeoutMs?: number;
+    /**
+     * Handle Sample Dump Standard ACK, NAK, WAIT and CANCEL replies from the
+     * device. Defaults to false.
+     */
+    handshake?: boolean;
+    /** Number of times to resend the request after a NAK. Defaults to 0 */
+    retries?: number;
+    /**
+     * Time a device may hold the request with WAIT before it times out.
+     * Defaults to 10000
+     */
+    waitMs?: number;
+}
+/** Counters kept natively for a port, or summed over the whole process */
+export interface PortStats {
+    messagesIn: number;
+    bytesIn: number;
+    messagesOut: number;
+    bytesOut: number;
+    /** Sysex messages in either direction */
+    sysex: number;
+    dropped: {
+        /** Input events discarded because the port was closing */
+        closed: number;
+        /** Input messages which could not be converted to UMP */
+        conversion: number;
+        /** Output messages which the backend failed to send */
+        send: number;
+    };
+    /** Input events waiting for the JS thread */
+    queueDepth: number;
+    maxQueueDepth: number;
+    /** Events handed to the JS thread */
+    tsfnCalls: number;
+    /**
+     * Messages per call into the backend on output, or per run of events
+     * handled by the JS thread on input
+     */
+    averageBatchSize: number;
+    /** Calls into the backend send path */
+    writes: number;
+    /** UMP which could not be decoded on output */
+    encodeErrors: number;
+    /** Times the driver's input buffer overflowed and lost events, ALSA only */
+    overruns: number;
+    /** Controller changes dropped or held back by thinControllers() */
+    thinned: number;
+    /** Output controller changes replaced by a newer value, see coalesceControllers() */
+    coalesced: number;
+}
+export interface InputOverrun {
+    /** Overruns on this port so far */
+    overruns: number;
+    /** The driver's input pool size in events when it overflowed */
+    poolSize: number;
+}
+export interface InputStats extends PortStats {
+    /** The driver's input pool size in events, or 0 where there is none */
+    inputPool: number;
+}
+export interface OutputStats extends PortStats {
+    /** Sends which found the driver full, and queued output for a writer thread */
+    stalls: number;
+    /** Attempts by the writer thread to pass queued output to the driver */
+    retries: number;
+    /** Events waiting in the queue */
+    pending: number;
+    /** Bytes waiting in the lanes set up by setPriorityLanes() */
+    queuedBytes: number;
+}
 
 export class Input extends EventEmitter {
-    constructor()
+    constructor(api?: string)
 
     /** Close the midi port */
     closePort(): void;
@@ -41,8 +156,23 @@ export class Input extends EventEmitter {
      * openVirtualPort(portName) instead of openPort(portNumber).
      */
     openVirtualPort(port: string): void;
+    /**
+     * Move the open connection to another input port, or open it if none is
+     * open. The callback and the receiving thread are kept, and on ALSA the
+     * new source is connected before the old one is dropped, so switching is
+     * fast and loses nothing.
+     */
+    switchPort(port: number): void;
 
     on(event: 'message', callback: MidiCallback): this;
+    on(event: 'ump', callback: UmpCallback): this;
+    on(event: 'cc14' | 'rpn' | 'nrpn', callback: ParameterCallback): this;
+    on(event: 'chord', callback: ChordCallback): this;
+    /**
+     * The driver's input buffer overflowed and events were lost. Raise the
+     * pool with setInputPool() or setInputAutoGrow() to avoid this.
+     */
+    on(event: 'overrun', callback: (overrun: InputOverrun) => void): this;
     /**
      * Set the size of the internal buffer used to cache incoming MIDI messages.
      * The default size is 2048 bytes. The count parameter specifies the number
@@ -50,10 +180,93 @@ export class Input extends EventEmitter {
      * to 4.
      */
     setBufferSize(size: number, count?: number): void;
+    /**
+     * Size the driver's input pool in events and the client's input buffer
+     * in bytes, ALSA only. Zero leaves a size unchanged. Resizing the pool
+     * drops events waiting in it, and the buffer can only be resized before
+     * a port is opened.
+     */
+    setInputPool(poolSize: number, bufferSize?: number): void;
+    /**
+     * Double the input pool after each overrun, up to maxPoolSize events
+     * (the kernel accepts up to 2000). The pool is resized when no input is
+     * waiting, so queued events are kept, but an event arriving during the
+     * resize itself is lost. Zero turns this off. ALSA only.
+     */
+    setInputAutoGrow(maxPoolSize: number): void;
+    /**
+     * Translate incoming messages to Universal MIDI Packets. While enabled,
+     * 'ump' events are emitted in place of 'message' events. Protocol 2
+     * (the default) produces MIDI 2.0 channel voice packets, protocol 1
+     * keeps MIDI 1.0 channel voice packets.
+     */
+    enableUmp(protocol?: 1 | 2, group?: number): void;
+    /** Go back to emitting MIDI 1.0 'message' events */
+    disableUmp(): void;
+    /**
+     * Assemble high resolution controllers natively. Each enabled kind is
+     * emitted as a single 'cc14', 'rpn' or 'nrpn' event in place of the 2 to
+     * 4 messages that make it up. A 14-bit CC is only held back once its
+     * controller has been seen with an LSB; until then the MSB is a plain
+     * 'message'. An MSB whose LSB has not arrived within timeout milliseconds
+     * (default 10) is emitted on its own.
+     */
+    assembleParameters(cc14: boolean, rpn: boolean, nrpn: boolean, timeout?: number): void;
+    /**
+     * Group note ons, or note offs, arriving on one channel within window
+     * milliseconds (default 5) of the first into a single 'chord' event. A
+     * note with nothing else in its window is emitted as a 'message' event.
+     */
+    assembleChords(noteOns: boolean, noteOffs: boolean, window?: number): void;
+    /**
+     * Thin out controller, pitch bend and channel pressure changes before
+     * they reach JS. Later rules take precedence, and no rules turns
+     * thinning off.
+     */
+    thinControllers(rules?: ThinningRule[]): void;
+    /**
+     * Run rules over each incoming message of up to three bytes on the
+     * input thread, before any other processing. Only messages the rules
+     * forward or send to JS are emitted; the rest are dropped or sent
+     * straight on to outputs. Replaces any transform already set.
+     */
+    setTransform(program: TransformRule[] | TransformProgram): void;
+    clearTransform(): void;
+    /**
+     * Publish every message this port receives, before any other processing,
+     * to the named hub for Subscribers in any worker to read. The capacity in
+     * bytes (default 1MB) is only used if the hub doesn't exist yet.
+     */
+    publish(name: string, capacity?: number): void;
+    unpublish(): void;
+    /**
+     * Write everything this port receives to a capture file, with its
+     * timing, for replaying through a ReplayInput. The capture stops when the
+     * port is closed.
+     */
+    startCapture(path: string): void;
+    stopCapture(): void;
+    getStats(): InputStats;
+}
+
+/**
+ * Plays back a capture through the same processing as a live input, either
+ * with the recorded timing or as fast as possible. The capture is started by
+ * opening port 0, and 'end' is emitted once it has all been delivered. The
+ * port no longer counts as open by then.
+ */
+export class ReplayInput extends Input {
+    constructor(path: string, options?: { realtime?: boolean; api?: string })
+
+    on(event: 'message', callback: MidiCallback): this;
+    on(event: 'ump', callback: UmpCallback): this;
+    on(event: 'cc14' | 'rpn' | 'nrpn', callback: ParameterCallback): this;
+    on(event: 'chord', callback: ChordCallback): this;
+    on(event: 'end', callback: () => void): this;
 }
 
 export class Output {
-    constructor()
+    constructor(api?: string)
     
     /** Close the midi port */
     closePort(): void;
@@ -79,8 +292,304 @@ export class Output {
     send(message: MidiMessage): void;
     /** Send a MIDI message */
     sendMessage(message: MidiMessage): void;
+    /** Translate Universal MIDI Packets to MIDI 1.0 and send them */
+    sendUmp(words: Uint32Array | number[]): void;
+    /**
+     * Send many messages in one call to the backend, each given by its
+     * offset and length in data. Messages laid out back to back, as
+     * splitMessages() returns them, are sent without being copied.
+     */
+    sendMessages(data: Buffer, offsets: Uint32Array, lengths: Uint32Array): void;
+    sendMessages(messages: SplitMessages): void;
+    /**
+     * Send a sysex request and wait for the reply on an input. The input
+     * must be open and must not ignore sysex. Replies used to settle a
+     * request are not emitted as 'message' events.
+     */
+    request(message: MidiMessage | Buffer, options: RequestOptions): Promise<Buffer>;
+    /** Send a 14-bit value as an MSB/LSB pair, for controllers 0-31 */
+    cc14(channel: number, controller: number, value: number): void;
+    /**
+     * Send a 14-bit value to a registered parameter. The parameter number is
+     * only sent when it differs from the last one selected on the channel.
+     */
+    rpn(channel: number, param: number, value: number): void;
+    /**
+     * Send a 14-bit value to a non-registered parameter. The parameter number
+     * is only sent when it differs from the last one selected on the channel.
+     */
+    nrpn(channel: number, param: number, value: number): void;
+    /**
+     * Size the ALSA client's output pool in events and its output buffer in
+     * bytes, to absorb larger bursts before output has to be queued. Zero
+     * leaves a size unchanged. closePort() waits up to drainTimeoutMs for
+     * queued output to reach the driver, 1000 by default, and sends from
+     * other threads wait with it. Other APIs ignore this.
+     */
+    setOutputPool(poolSize: number, bufferSize?: number, drainTimeoutMs?: number): void;
+    /**
+     * Hold controller, pitch bend and channel pressure updates for windowMs,
+     * sending only the latest value of each. Infinity holds them until
+     * flush(). Other messages pass straight through, after any held values
+     * on their channel. Zero, the default, turns coalescing off.
+     */
+    coalesceControllers(windowMs?: number): void;
+    /** Send every update held by coalesceControllers() now */
+    flush(): void;
+    /**
+     * Queue sysex natively and send it no faster than options.rate bytes
+     * per second, 3125 by default, the speed of a DIN cable. System real
+     * time and channel messages are sent straight away instead of waiting
+     * behind it. On ALSA and loopback ports, sysex goes out in segments of
+     * options.chunkSize bytes, 32 by default, and real time messages are sent
+     * between them.
+     * Turning the lanes off sends anything still queued at once.
+     */
+    setPriorityLanes(enable: boolean, options?: { rate?: number, chunkSize?: number }): void;
+    getStats(): OutputStats;
+}
+
+export interface SequencerStep {
+    /** Note to play, ignored when arpeggiating (default 60) */
+    note?: number;
+    /** 0 takes the velocity of the held note when arpeggiating (default 100) */
+    velocity?: number;
+    /** Chance of the step playing, 0 to 1 (default 1) */
+    probability?: number;
+    /** Overrides the pattern's gate for this step */
+    gate?: number;
+    rest?: boolean;
+}
+export interface SequencerPattern {
+    /** Beats per minute (default 120) */
+    tempo?: number;
+    /** Steps per beat (default 4) */
+    division?: number;
+    /** Delay of every second step as a fraction of a step, up to 0.75 (default 0) */
+    swing?: number;
+    /** Fraction of a step each note is held for (default 0.5) */
+    gate?: number;
+    /** Zero based (default 0) */
+    channel?: number;
+    /**
+     * 'steps' plays the notes of the steps, the others arpeggiate the notes
+     * held on the followed input (default 'steps')
+     */
+    mode?: 'steps' | 'up' | 'down' | 'updown' | 'random' | 'played';
+    /** Octaves an arpeggio spans (default 1) */
+    octaves?: number;
+    /** Cycled through in order, every step plays when empty */
+    steps?: SequencerStep[];
+    /** Reseed the random numbers behind probability and 'random' mode */
+    seed?: number;
+}
+
+/**
+ * Plays a pattern through an output from a native timing thread. Changes
+ * made with set() are merged into the current pattern and take over at the
+ * next step boundary.
+ */
+export class Sequencer {
+    constructor(output: Output, pattern?: SequencerPattern)
+
+    set(changes: SequencerPattern): void;
+    start(): void;
+    /** Stop, ending any notes still sounding */
+    stop(): void;
+    isRunning(): boolean;
+    /** Steps played or skipped since the last start */
+    getStep(): number;
+    /** Arpeggiate the notes held on an input */
+    follow(input: Input): void;
+    unfollow(): void;
+}
+
+/**
+ * Reads the messages published to a hub by Input.publish(), each subscriber
+ * through its own cursor. A subscriber which falls a whole hub behind skips
+ * to the oldest message still held, and emits 'lag' with how many it missed,
+ * rather than holding up the input or the other subscribers.
+ */
+export class Subscriber extends EventEmitter {
+    constructor(name: string, capacity?: number)
+
+    on(event: 'message', callback: MidiCallback): this;
+    on(event: 'lag', callback: (lost: number) => void): this;
+    on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+    close(): void;
+    /** Messages missed through falling behind since the subscriber was created */
+    getLost(): number;
+}
+
+export interface RecordedEvent {
+    /** Wall clock time in milliseconds since the epoch */
+    time: number;
+    /** Number identifying the port within the recording process */
+    port: number;
+    direction: 'in' | 'out';
+    message: MidiMessage;
+}
+
+export interface Recording {
+    /** Names of the ports opened while recording, by port number */
+    ports: { [port: number]: { name: string; direction: 'in' | 'out' } };
+    events: RecordedEvent[];
 }
 
+export namespace FlightRecorder {
+    /**
+     * Record every message sent or received by any port in this process into
+     * a ring in a memory-mapped file, which survives the process crashing.
+     * Recording resumes where it left off if the file already exists with
+     * the same size. Defaults to 16MB.
+     */
+    function start(path: string, size?: number): void;
+    function stop(): void;
+    /** Read a recording, optionally limited to a window of wall clock time */
+    function read(path: string, window?: { since?: Date | number; until?: Date | number }): Recording;
+    function toJson(recording: Recording): string;
+    /** Convert to a Standard MIDI File, with a track per port and direction */
+    function toSmf(recording: Recording): Buffer;
+}
+
+/** Names of the APIs which can be passed to the Input and Output constructors */
+export const Api: {
+    readonly UNSPECIFIED: undefined;
+    readonly CORE: 'core';
+    readonly ALSA: 'alsa';
+    readonly JACK: 'jack';
+    readonly WINMM: 'winmm';
+    readonly UWP: 'uwp';
+    /** Ports which only exist inside this process, see setLoopbackLatency() */
+    readonly LOOPBACK: 'loopback';
+    /** Ports on a shared memory bus between processes, see setBusName(). Not on Windows. */
+    readonly SHM: 'shm';
+    /**
+     * RTP-MIDI network sessions, see addRtpPeer() and setRtpPort(). Not on Windows.
+     * Messages are timed from when their packet arrived; clock sync only keeps
+     * the session alive.
+     */
+    readonly RTP: 'rtp';
+};
+
+/**
+ * Names of the input ports of an API, indexed by port number. Uses one
+ * client per API shared by the whole process, so this is cheaper than
+ * creating an Input to look.
+ */
+export function listInputs(api?: string): string[];
+/** Names of the output ports of an API, indexed by port number */
+export function listOutputs(api?: string): string[];
+
+export interface SplitMessages {
+    /** The complete messages, back to back */
+    data: Buffer;
+    offsets: Uint32Array;
+    lengths: Uint32Array;
+    /** Bytes which were not part of a complete message */
+    dropped: number;
+}
+
+/**
+ * Split a raw MIDI byte stream into complete messages. Running status is
+ * expanded, realtime bytes are moved ahead of the message they interrupt,
+ * and incomplete messages are dropped.
+ */
+export function splitMessages(data: Buffer | Uint8Array | number[]): SplitMessages;
+
+export type TransformType =
+    | 'noteoff' | 'noteon' | 'polypressure' | 'cc' | 'program' | 'pressure' | 'pitchbend'
+    | 'mtc' | 'songposition' | 'songselect' | 'tunerequest'
+    | 'clock' | 'start' | 'continue' | 'stop' | 'activesensing' | 'reset';
+export type TransformField =
+    | 'status' | 'type' | 'channel' | 'length'
+    | 'data1' | 'note' | 'controller' | 'data2' | 'velocity' | 'value';
+/** A number, or [min, max] inclusive */
+export type TransformCondition = number | [number, number];
+/**
+ * A constant, a field of the incoming message, or a field put through map
+ * (a lookup table), scale ([inMin, inMax, outMin, outMax]), mul, div, add,
+ * min and max, in that order. Data bytes are clamped to 0-127 when sent.
+ */
+export type TransformValue = number | TransformField | {
+    from: TransformField;
+    map?: number[];
+    scale?: [number, number, number, number];
+    mul?: number;
+    div?: number;
+    add?: number;
+    min?: number;
+    max?: number;
+};
+export interface TransformMessage {
+    /** A fixed status byte, in place of type and channel */
+    status?: number;
+    type?: TransformType | number;
+    /** Defaults to the incoming channel */
+    channel?: TransformValue;
+    /** Data bytes default to those of the incoming message */
+    data1?: TransformValue;
+    note?: TransformValue;
+    controller?: TransformValue;
+    data2?: TransformValue;
+    velocity?: TransformValue;
+    value?: TransformValue;
+    /** Where to send the message, JS when left out */
+    to?: Output;
+}
+export interface TransformRule {
+    /** Every condition must hold for the rule to apply, an empty match takes everything */
+    match?: { [field in TransformField]?: TransformCondition } & { type?: TransformType | number };
+    /** Pass the incoming message on unchanged, true for JS */
+    forward?: true | Output | Array<true | Output>;
+    send?: TransformMessage | TransformMessage[];
+    /** Go on to the next rule after this one applies, rather than stopping */
+    continue?: boolean;
+}
+export interface TransformProgram {
+    code: Uint32Array;
+    tables: Int32Array[];
+    outputs: Output[];
+}
+
+/**
+ * Compile transform rules ahead of time. Each message is checked against
+ * the rules in order and the first it matches decides its fate; messages
+ * which match no rule are dropped.
+ */
+export function compileRules(rules: TransformRule[]): TransformProgram;
+
+/** Delay every message sent over the loopback API by the given milliseconds */
+export function setLoopbackLatency(ms: number): void;
+
+/**
+ * Use the named shared memory bus for shm ports created after this call,
+ * 'rtmidi' by default. Every process using the same name sees the same ports.
+ */
+export function setBusName(name: string): void;
+
+/**
+ * Listen for RTP-MIDI sessions on the given UDP port, and the data port after
+ * it, when a virtual rtp port is opened. 5004 by default.
+ */
+export function setRtpPort(port: number): void;
+
+/**
+ * Add a peer which rtp ports list under the given name, replacing any peer
+ * with the same name. Opening its port invites the peer into a session.
+ */
+export function addRtpPeer(name: string, host: string, port?: number): void;
+
+/** Remove a peer added by addRtpPeer(), returning whether there was one */
+export function removeRtpPeer(name: string): boolean;
+
+/** Drop the given fraction of rtp packets sent, for testing recovery */
+export function setRtpPacketLoss(fraction: number): void;
+
+/** Counters summed over every port this process has opened */
+export function getStats(): PortStats;
+
 /** @deprecated */
 export const input: typeof Input;
 /** @deprecated */
@@ -17,13 +17,28 @@ const Drums = require('./lib/drums');
 const Notes = require('./lib/notes');
 /** Message names, including CCs */
 const Messages = require('./lib/messages');
+/** Reader for flight recorder files */
+const recorder = require('./lib/recorder');
+/** Compiler for input transform rules */
+const transform = require('./lib/transform');
 
 class Input extends EventEmitter {
   constructor(api) {
     super()
 
-    this.input = new midi.Input((deltaTime, message) => {
-      this.emit('message', deltaTime, Array.from(message.values()))
+    this.input = new midi.Input((deltaTime, message, type) => {
+      switch (type) {
+        case undefined:
+          this.emit('message', deltaTime, Array.from(message.values()))
+          break
+        case 'overrun':
+          this.emit('overrun', message)
+          break
+        default:
+          // 'ump', 'cc14', 'rpn', 'nrpn', 'chord' and 'end' events are passed through as-is
+          this.emit(type, deltaTime, message)
+          break
+      }
     }, api)
   }
 
@@ -59,9 +74,94 @@ class Input extends EventEmitter {
   openVirtualPort(port) {
     return this.input.openVirtualPort(port)
   }
+  switchPort(port) {
+    return this.input.switchPort(port)
+  }
   setBufferSize(size, count = 4) {
     return this.input.setBufferSize(size, count)
   }
+  setInputPool(poolSize, bufferSize = 0) {
+    return this.input.setInputPool(poolSize, bufferSize)
+  }
+  setInputAutoGrow(maxPoolSize) {
+    return this.input.setInputAutoGrow(maxPoolSize)
+  }
+  enableUmp(protocol = 2, group = 0) {
+    return this.input.enableUmp(protocol, group)
+  }
+  disableUmp() {
+    return this.input.disableUmp()
+  }
+  assembleParameters(cc14, rpn, nrpn, timeout = 10) {
+    return this.input.assembleParameters(cc14, rpn, nrpn, timeout)
+  }
+  assembleChords(noteOns, noteOffs, window = 5) {
+    return this.input.assembleChords(noteOns, noteOffs, window)
+  }
+  thinControllers(rules = []) {
+    return this.input.thinControllers(rules.map(({ channel = -1, controller = -1, deadband = 0, hysteresis = 0, rate = 0 }) => ({
+      channel,
+      controller: controller === 'pitchbend' ? 128 : controller === 'pressure' ? 129 : controller,
+      deadband,
+      hysteresis,
+      rate,
+    })))
+  }
+  setTransform(program) {
+    if (Array.isArray(program)) {
+      program = transform.compile(program)
+    }
+    const outputs = program.outputs.map((output) => output.output || output)
+    return this.input.setTransform(program.code, program.tables, outputs)
+  }
+  clearTransform() {
+    return this.input.clearTransform()
+  }
+  publish(name, capacity = 1 << 20) {
+    return this.input.publish(name, capacity)
+  }
+  unpublish() {
+    return this.input.unpublish()
+  }
+  startCapture(path) {
+    return this.input.startCapture(path)
+  }
+  stopCapture() {
+    return this.input.stopCapture()
+  }
+  getStats() {
+    return this.input.getStats()
+  }
+}
+
+// An input which plays back a capture made with Input.startCapture(), through
+// the same processing as a live port. Emits 'end' once the capture is done.
+class ReplayInput extends Input {
+  constructor(path, { realtime = true, api } = {}) {
+    super(api)
+
+    this.path = path
+    this.realtime = realtime
+  }
+
+  getPortCount() {
+    return 1
+  }
+  getPortName(port) {
+    return port === 0 ? this.path : ''
+  }
+  openPort(port = 0) {
+    if (port !== 0) {
+      throw new RangeError('Invalid MIDI port number')
+    }
+    return this.input.replay(this.path, this.realtime)
+  }
+  openPortByName(name) {
+    return name === this.path ? this.openPort(0) : undefined
+  }
+  openVirtualPort() {
+    throw new Error('A replay input has no virtual port')
+  }
 }
 
 class Output {
@@ -111,9 +211,116 @@ class Output {
 
     return this.output.sendMessage(message)
   }
+  sendUmp(words) {
+    if (Array.isArray(words)) {
+      words = Uint32Array.from(words)
+    }
+    if (!(words instanceof Uint32Array)) {
+      throw new Error('First argument must be an array or Uint32Array')
+    }
+
+    return this.output.sendUmp(words)
+  }
+  sendMessages(data, offsets, lengths) {
+    if (offsets === undefined && data && data.offsets) {
+      // The result of splitMessages()
+      ({ data, offsets, lengths } = data)
+    }
+
+    return this.output.sendMessages(data, offsets, lengths)
+  }
+  request(message, options = {}) {
+    try {
+      if (Array.isArray(message)) {
+        message = Buffer.from(message)
+      }
+      if (!Buffer.isBuffer(message)) {
+        throw new Error('First argument must be an array or Buffer')
+      }
+
+      const { input, match, timeoutMs = 1000, handshake = false, retries = 0, waitMs = 10000 } = options
+      if (!(input instanceof Input)) {
+        throw new Error('options.input must be an Input')
+      }
+
+      let pattern
+      if (match !== undefined && match !== null) {
+        // null or undefined entries in the match are wildcards
+        pattern = Array.from(match, (byte) => (byte === null || byte === undefined ? -1 : byte))
+      } else if (handshake) {
+        // Settled by the device's ACK alone
+        pattern = []
+      } else {
+        // Any sysex from the same manufacturer
+        pattern = Array.from(message.subarray(0, message[1] === 0 ? 4 : 2))
+      }
+
+      return this.output.request(message, input.input, pattern, timeoutMs, handshake, retries, waitMs)
+    } catch (e) {
+      return Promise.reject(e)
+    }
+  }
+  cc14(channel, controller, value) {
+    return this.output.cc14(channel, controller, value)
+  }
+  rpn(channel, param, value) {
+    return this.output.rpn(channel, param, value)
+  }
+  nrpn(channel, param, value) {
+    return this.output.nrpn(channel, param, value)
+  }
+  setOutputPool(poolSize, bufferSize = 0, drainTimeoutMs) {
+    return this.output.setOutputPool(poolSize, bufferSize, drainTimeoutMs)
+  }
+  coalesceControllers(windowMs = 0) {
+    return this.output.coalesceControllers(windowMs)
+  }
+  flush() {
+    return this.output.flush()
+  }
+  setPriorityLanes(enable, { rate = 3125, chunkSize = 32 } = {}) {
+    return this.output.setPriorityLanes(enable, rate, chunkSize)
+  }
+  getStats() {
+    return this.output.getStats()
+  }
 }
 
 
+// Plays step patterns, or arpeggiates the notes held on an input, from a
+// native timing thread. Changes take effect at the next step.
+class Sequencer {
+  constructor(output, pattern = {}) {
+    this.sequencer = new midi.Sequencer(output.output)
+    this.pattern = {}
+    this.set(pattern)
+  }
+  set(changes) {
+    const { seed, ...rest } = changes
+    const pattern = { ...this.pattern, ...rest }
+    this.sequencer.setPattern(seed === undefined ? pattern : { ...pattern, seed })
+    this.pattern = pattern
+  }
+  start() {
+    return this.sequencer.start()
+  }
+  stop() {
+    return this.sequencer.stop()
+  }
+  isRunning() {
+    return this.sequencer.isRunning()
+  }
+  getStep() {
+    return this.sequencer.getStep()
+  }
+  follow(input) {
+    return this.sequencer.follow(input.input)
+  }
+  unfollow() {
+    return this.sequencer.unfollow()
+  }
+}
+
 function createReadStream(input) {
   input = input || new Input();
   var stream = new Stream();
@@ -174,6 +381,19 @@ function createWriteStream(output) {
   return stream;
 };
 
+const FlightRecorder = {
+  // Record every message on every port into a ring file of the given size
+  start(path, size = 16 * 1024 * 1024) {
+    return midi.startRecorder(path, size)
+  },
+  stop() {
+    return midi.stopRecorder()
+  },
+  read: recorder.read,
+  toJson: recorder.toJson,
+  toSmf: recorder.toSmf,
+};
+
 const Api = Object.freeze({
   UNSPECIFIED: undefined,
   CORE: 'core',
@@ -181,13 +401,115 @@ const Api = Object.freeze({
   JACK: 'jack',
   WINMM: 'winmm',
   UWP: 'uwp',
+  LOOPBACK: 'loopback',
+  SHM: 'shm',
+  RTP: 'rtp',
 });
 
+// Counters summed over every port in the process, including closed ones
+function getStats() {
+  return midi.getStats()
+}
+
+// Split a raw MIDI byte stream into complete messages, packed back to back
+function splitMessages(data) {
+  if (Array.isArray(data)) {
+    data = Buffer.from(data)
+  } else if (data instanceof Uint8Array && !Buffer.isBuffer(data)) {
+    data = Buffer.from(data.buffer, data.byteOffset, data.byteLength)
+  }
+
+  return midi.splitMessages(data)
+}
+
+// Compile rules for Input.setTransform(), for reuse across inputs
+function compileRules(rules) {
+  return transform.compile(rules)
+}
+
+// Port names for an api, without creating an Input or Output
+function listInputs(api) {
+  return midi.listInputs(api)
+}
+
+function listOutputs(api) {
+  return midi.listOutputs(api)
+}
+
+// Delay every message sent over the loopback API, to simulate a real link
+function setLoopbackLatency(ms) {
+  return midi.setLoopbackLatency(ms)
+}
+
+// Choose the shared memory bus that ports created after this use
+function setBusName(name) {
+  return midi.setBusName(name)
+}
+
+// Choose the UDP port virtual rtp ports listen for sessions on, the data
+// port is the one after it
+function setRtpPort(port) {
+  return midi.setRtpPort(port)
+}
+
+// Add a session peer, which rtp ports list by name
+function addRtpPeer(name, host, port = 5004) {
+  return midi.addRtpPeer(name, host, port)
+}
+
+function removeRtpPeer(name) {
+  return midi.removeRtpPeer(name)
+}
+
+// Drop this fraction of the rtp packets sent, to exercise recovery
+function setRtpPacketLoss(fraction) {
+  return midi.setRtpPacketLoss(fraction)
+}
+
+// Receives the messages an Input publishes to a hub, from any worker. Emits
+// 'lag' with the number of messages it missed when it falls too far behind.
+class Subscriber extends EventEmitter {
+  constructor(name, capacity = 1 << 20) {
+    super()
+
+    this.subscriber = new midi.Subscriber(name, capacity, (deltaTime, message, type) => {
+      if (type === 'lag') {
+        this.emit('lag', deltaTime)
+      } else {
+        this.emit('message', deltaTime, Array.from(message.values()))
+      }
+    })
+  }
+
+  close() {
+    return this.subscriber.close()
+  }
+  getLost() {
+    return this.subscriber.getLost()
+  }
+}
+
 module.exports = {
   Input,
   Output,
+  ReplayInput,
+  Sequencer,
+  Subscriber,
 
   Api,
+  listInputs,
+  listOutputs,
+  setLoopbackLatency,
+  setBusName,
+  setRtpPort,
+  addRtpPeer,
+  removeRtpPeer,
+  setRtpPacketLoss,
+  splitMessages,
+  compileRules,
+
+  FlightRecorder,
+  getStats,
 
   createReadStream,
   createWriteStream,
@@ -0,0 +1,115 @@
+#include <cstring>
+
+#include "capture.h"
+
+static const char CAPTURE_MAGIC[4] = {'N', 'M', 'C', 'P'};
+static const uint32_t CAPTURE_VERSION = 1;
+static const size_t CAPTURE_HEADER_SIZE = 16;
+static const size_t CAPTURE_RECORD_SIZE = 14;
+
+CaptureWriter::CaptureWriter()
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const std::string &path)
+{
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // Writes happen on the input thread, so keep them off the disk as long as possible
+    setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+
+    unsigned char header[CAPTURE_HEADER_SIZE] = {0};
+    memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    memcpy(header + 4, &CAPTURE_VERSION, sizeof(CAPTURE_VERSION));
+
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (file != nullptr)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void CaptureWriter::write(uint64_t time, uint16_t port, const unsigned char *message, size_t length)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    uint32_t size = static_cast<uint32_t>(length);
+
+    unsigned char record[CAPTURE_RECORD_SIZE];
+    memcpy(record, &time, sizeof(time));
+    memcpy(record + 8, &port, sizeof(port));
+    memcpy(record + 10, &size, sizeof(size));
+
+    fwrite(record, sizeof(record), 1, file);
+    fwrite(message, 1, length, file);
+}
+
+bool readCapture(const std::string &path, std::vector<CaptureEvent> &events)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    unsigned char header[CAPTURE_HEADER_SIZE];
+    uint32_t version;
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    memcpy(&version, header + 4, sizeof(version));
+    if (version != CAPTURE_VERSION)
+    {
+        fclose(file);
+        return false;
+    }
+
+    unsigned char record[CAPTURE_RECORD_SIZE];
+    while (fread(record, sizeof(record), 1, file) == 1)
+    {
+        CaptureEvent event;
+        uint32_t length;
+        memcpy(&event.time, record, sizeof(event.time));
+        memcpy(&event.port, record + 8, sizeof(event.port));
+        memcpy(&length, record + 10, sizeof(length));
+
+        event.message.resize(length);
+        if (length > 0 && fread(event.message.data(), length, 1, file) != 1)
+        {
+            break;
+        }
+
+        events.push_back(std::move(event));
+    }
+
+    fclose(file);
+    return true;
+}
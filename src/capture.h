@@ -0,0 +1,41 @@
+#ifndef NODE_MIDI_CAPTURE_H
+#define NODE_MIDI_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Capture files hold an input stream for replaying later. The layout, in
+// little-endian, is a 16 byte header of "NMCP", u32 version and 8 reserved
+// bytes, followed by packed records of u64 time in ns since the capture
+// started, u16 port, u32 length and then length bytes of message.
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void write(uint64_t time, uint16_t port, const unsigned char *message, size_t length);
+
+private:
+    FILE *file = nullptr;
+};
+
+struct CaptureEvent
+{
+    uint64_t time;
+    uint16_t port;
+    std::vector<unsigned char> message;
+};
+
+// Reads a whole capture, returning false if the file is not a capture. A
+// record cut short by the capture being interrupted is ignored.
+bool readCapture(const std::string &path, std::vector<CaptureEvent> &events);
+
+#endif // NODE_MIDI_CAPTURE_H
@@ -0,0 +1,85 @@
+#include "chords.h"
+
+void ChordAssembler::configure(const Options &newOptions)
+{
+    options = newOptions;
+    reset();
+}
+
+void ChordAssembler::reset()
+{
+    collecting = false;
+    pending.notes.clear();
+    pending.velocities.clear();
+}
+
+bool ChordAssembler::process(const unsigned char *message, size_t length, double time, Clock::time_point now, std::vector<Chord> &out)
+{
+    // Real time messages can arrive in the middle of a chord, and go
+    // straight through without ending it
+    if (length > 0 && message[0] >= 0xF8)
+    {
+        return false;
+    }
+
+    uint8_t type = length == 3 ? message[0] & 0xF0 : 0;
+    if (type != 0x80 && type != 0x90)
+    {
+        flush(out);
+        return false;
+    }
+
+    bool on = type == 0x90 && message[2] > 0;
+    if (!(on ? options.noteOns : options.noteOffs))
+    {
+        flush(out);
+        return false;
+    }
+
+    uint8_t channel = message[0] & 0x0F;
+    if (collecting && pending.on == on && pending.channel == channel && now < deadline)
+    {
+        pending.notes.push_back(message[1]);
+        pending.velocities.push_back(message[2]);
+        return true;
+    }
+
+    flush(out);
+
+    collecting = true;
+    pending.status = message[0];
+    pending.channel = channel;
+    pending.on = on;
+    pending.notes.assign(1, message[1]);
+    pending.velocities.assign(1, message[2]);
+    pending.time = time;
+    deadline = now + options.window;
+    return true;
+}
+
+ChordAssembler::Clock::time_point ChordAssembler::expire(Clock::time_point now, std::vector<Chord> &out)
+{
+    if (!collecting)
+    {
+        return Clock::time_point::max();
+    }
+
+    if (now >= deadline)
+    {
+        flush(out);
+        return Clock::time_point::max();
+    }
+
+    return deadline;
+}
+
+void ChordAssembler::flush(std::vector<Chord> &out)
+{
+    if (!collecting)
+    {
+        return;
+    }
+
+    out.push_back(pending);
+    reset();
+}
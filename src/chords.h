@@ -0,0 +1,59 @@
+#ifndef NODE_MIDI_CHORDS_H
+#define NODE_MIDI_CHORDS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Groups note ons, or note offs, which arrive on one channel within a short
+// window of the first into a single chord. Any other message ends the chord
+// being collected, so events keep their order.
+class ChordAssembler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chord
+    {
+        // Status of the first note, a note on with velocity 0 counts as a note off
+        uint8_t status;
+        uint8_t channel;
+        bool on;
+        std::vector<uint8_t> notes;
+        std::vector<uint8_t> velocities;
+        // Stream time of the first note
+        double time;
+    };
+
+    struct Options
+    {
+        bool noteOns = false;
+        bool noteOffs = false;
+        Clock::duration window = std::chrono::milliseconds(5);
+    };
+
+    // Replaces the options and discards any partial chord
+    void configure(const Options &options);
+    const Options &getOptions() const { return options; }
+    bool isEnabled() const { return options.noteOns || options.noteOffs; }
+
+    // Returns true when the message was consumed. Appends the chord it
+    // ended, if any, which may hold a single note.
+    bool process(const unsigned char *message, size_t length, double time, Clock::time_point now, std::vector<Chord> &out);
+
+    // Completes the chord once its window has passed, and returns the next deadline
+    Clock::time_point expire(Clock::time_point now, std::vector<Chord> &out);
+
+    void reset();
+
+private:
+    Options options;
+    bool collecting = false;
+    Chord pending;
+    Clock::time_point deadline;
+
+    void flush(std::vector<Chord> &out);
+};
+
+#endif // NODE_MIDI_CHORDS_H
@@ -0,0 +1,154 @@
+#include <cstring>
+
+#include "coalescer.h"
+
+ControllerCoalescer::ControllerCoalescer()
+{
+    reset();
+}
+
+void ControllerCoalescer::configure(bool enable, Clock::duration newWindow)
+{
+    enabled = enable;
+    window = newWindow;
+    reset();
+}
+
+void ControllerCoalescer::reset()
+{
+    for (int channel = 0; channel < 16; channel++)
+    {
+        for (int controller = 0; controller < Controllers; controller++)
+        {
+            slots[channel][controller].held = false;
+        }
+    }
+
+    order.clear();
+}
+
+int ControllerCoalescer::controllerOf(const unsigned char *message, size_t length)
+{
+    switch (message[0] & 0xF0)
+    {
+    case 0xB0:
+        if (length != 3)
+        {
+            return -1;
+        }
+        // Data entry, increment and decrement, parameter numbers and channel mode
+        if (message[1] == 6 || message[1] == 38 || (message[1] >= 96 && message[1] <= 101) || message[1] >= 120)
+        {
+            return -1;
+        }
+        return message[1];
+    case 0xD0:
+        return length == 2 ? Pressure : -1;
+    case 0xE0:
+        return length == 3 ? PitchBend : -1;
+    default:
+        return -1;
+    }
+}
+
+ControllerCoalescer::Result ControllerCoalescer::process(const unsigned char *message, size_t length, Clock::time_point now,
+                                                         std::vector<unsigned char> &bytes, std::vector<size_t> &sizes, Clock::time_point &deadline)
+{
+    int controller = length > 0 ? controllerOf(message, length) : -1;
+    if (controller < 0)
+    {
+        if (length > 0 && message[0] < 0xF0)
+        {
+            flushChannel(message[0] & 0x0F, bytes, sizes);
+        }
+        else if (length > 0 && message[0] < 0xF8)
+        {
+            flush(bytes, sizes);
+        }
+
+        // Real time messages don't change any state, so they go straight out
+        bytes.insert(bytes.end(), message, message + length);
+        sizes.push_back(length);
+        return Passed;
+    }
+
+    uint8_t channel = message[0] & 0x0F;
+    Slot &slot = slots[channel][controller];
+    memcpy(slot.bytes, message, length);
+    slot.length = static_cast<uint8_t>(length);
+    if (slot.held)
+    {
+        return Superseded;
+    }
+
+    slot.held = true;
+    slot.since = now;
+    order.push_back(static_cast<uint16_t>(channel * Controllers + controller));
+    if (window > Clock::duration::zero())
+    {
+        deadline = now + window;
+    }
+    return Held;
+}
+
+void ControllerCoalescer::release(size_t position, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes)
+{
+    Slot &slot = slots[order[position] / Controllers][order[position] % Controllers];
+    bytes.insert(bytes.end(), slot.bytes, slot.bytes + slot.length);
+    sizes.push_back(slot.length);
+    slot.held = false;
+}
+
+void ControllerCoalescer::flushChannel(uint8_t channel, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        if (order[i] / Controllers == channel)
+        {
+            release(i, bytes, sizes);
+        }
+        else
+        {
+            order[kept++] = order[i];
+        }
+    }
+    order.resize(kept);
+}
+
+void ControllerCoalescer::flush(std::vector<unsigned char> &bytes, std::vector<size_t> &sizes)
+{
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        release(i, bytes, sizes);
+    }
+    order.clear();
+}
+
+ControllerCoalescer::Clock::time_point ControllerCoalescer::expire(Clock::time_point now, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes)
+{
+    if (window == Clock::duration::zero())
+    {
+        return Clock::time_point::max();
+    }
+
+    // Every slot has the same window, so the due ones are at the front
+    size_t due = 0;
+    while (due < order.size())
+    {
+        const Slot &slot = slots[order[due] / Controllers][order[due] % Controllers];
+        if (slot.since + window > now)
+        {
+            break;
+        }
+        release(due, bytes, sizes);
+        due++;
+    }
+    order.erase(order.begin(), order.begin() + due);
+
+    if (order.empty())
+    {
+        return Clock::time_point::max();
+    }
+    return slots[order[0] / Controllers][order[0] % Controllers].since + window;
+}
@@ -0,0 +1,74 @@
+#ifndef NODE_MIDI_COALESCER_H
+#define NODE_MIDI_COALESCER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Holds controller, pitch bend and channel pressure updates on their way
+// out, so that only the latest value of each is sent once its window is up.
+// Held values go out in the order they were first held, and always ahead of
+// any other message on their channel, or of any system common message, so
+// the stream keeps its order and only loses values that were superseded.
+// The parameter number and data entry controllers are never held, as their
+// meaning depends on the ones around them.
+class ControllerCoalescer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Controller numbers above the CCs
+    static const int PitchBend = 128;
+    static const int Pressure = 129;
+    static const int Controllers = 130;
+
+    enum Result
+    {
+        // Appended, after any held values it has to follow
+        Passed,
+        Held,
+        // Held in place of an earlier value, which is dropped
+        Superseded,
+    };
+
+    ControllerCoalescer();
+
+    // A zero window holds values until flush(). Discards any held values.
+    void configure(bool enable, Clock::duration window);
+    bool isEnabled() const { return enabled; }
+
+    // Appends whatever has to be sent now to bytes and sizes. When a new
+    // value is held, deadline is set to when it is due.
+    Result process(const unsigned char *message, size_t length, Clock::time_point now,
+                   std::vector<unsigned char> &bytes, std::vector<size_t> &sizes, Clock::time_point &deadline);
+
+    // Appends the held values which are due, and returns the next deadline
+    Clock::time_point expire(Clock::time_point now, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes);
+
+    // Appends every held value
+    void flush(std::vector<unsigned char> &bytes, std::vector<size_t> &sizes);
+
+    void reset();
+
+private:
+    struct Slot
+    {
+        bool held;
+        unsigned char bytes[3];
+        uint8_t length;
+        Clock::time_point since;
+    };
+
+    bool enabled = false;
+    Clock::duration window = Clock::duration::zero();
+    Slot slots[16][Controllers];
+    // Indexes of the held slots, oldest first
+    std::vector<uint16_t> order;
+
+    static int controllerOf(const unsigned char *message, size_t length);
+    void release(size_t position, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes);
+    void flushChannel(uint8_t channel, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes);
+};
+
+#endif // NODE_MIDI_COALESCER_H
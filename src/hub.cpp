@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstring>
+
+#include "hub.h"
+
+namespace
+{
+    uint64_t alignRecord(uint64_t size)
+    {
+        return (size + 7) & ~static_cast<uint64_t>(7);
+    }
+}
+
+std::shared_ptr<MessageHub> MessageHub::get(const std::string &name, size_t capacity)
+{
+    // Deliberately leaked, so hubs released from late finalisers stay safe
+    static std::mutex *registryMutex = new std::mutex();
+    static std::map<std::string, std::weak_ptr<MessageHub>> *registry = new std::map<std::string, std::weak_ptr<MessageHub>>();
+
+    std::lock_guard<std::mutex> lock(*registryMutex);
+
+    std::shared_ptr<MessageHub> hub = (*registry)[name].lock();
+    if (!hub)
+    {
+        hub = std::make_shared<MessageHub>(capacity);
+        (*registry)[name] = hub;
+    }
+
+    // Forget hubs nobody holds any more
+    for (std::map<std::string, std::weak_ptr<MessageHub>>::iterator it = registry->begin(); it != registry->end();)
+    {
+        it = it->second.expired() ? registry->erase(it) : std::next(it);
+    }
+
+    return hub;
+}
+
+MessageHub::MessageHub(size_t capacity)
+    : capacity(std::max<size_t>(capacity & ~static_cast<size_t>(7), 4096)),
+      ring(new unsigned char[this->capacity])
+{
+}
+
+void MessageHub::write(uint64_t offset, const void *data, size_t length)
+{
+    size_t position = offset % capacity;
+    size_t first = std::min(length, capacity - position);
+    memcpy(ring.get() + position, data, first);
+    memcpy(ring.get(), static_cast<const unsigned char *>(data) + first, length - first);
+}
+
+void MessageHub::copy(uint64_t offset, void *data, size_t length) const
+{
+    size_t position = offset % capacity;
+    size_t first = std::min(length, capacity - position);
+    memcpy(data, ring.get() + position, first);
+    memcpy(static_cast<unsigned char *>(data) + first, ring.get(), length - first);
+}
+
+void MessageHub::publish(const unsigned char *message, size_t length, double time)
+{
+    uint64_t size = alignRecord(sizeof(Record) + length);
+    if (size > capacity)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t start = head.load(std::memory_order_relaxed);
+    uint64_t oldest = tail.load(std::memory_order_relaxed);
+    while (start + size - oldest > capacity)
+    {
+        Record record;
+        copy(oldest, &record, sizeof(record));
+        oldest += alignRecord(sizeof(Record) + record.length);
+    }
+
+    // Readers must see the new tail before any of the bytes that replace
+    // what it moved past
+    tail.store(oldest, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Record record = {sequence++, time, static_cast<uint32_t>(length), 0};
+    write(start, &record, sizeof(record));
+    write(start + sizeof(record), message, length);
+    head.store(start + size, std::memory_order_release);
+
+    for (std::pair<const uint64_t, Notify> &subscriber : subscribers)
+    {
+        subscriber.second();
+    }
+}
+
+MessageHub::Cursor MessageHub::subscribe(Notify notify, uint64_t &id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    id = nextId++;
+    subscribers[id] = std::move(notify);
+
+    Cursor cursor;
+    cursor.position = head.load(std::memory_order_relaxed);
+    cursor.sequence = sequence;
+    return cursor;
+}
+
+void MessageHub::unsubscribe(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribers.erase(id);
+}
+
+bool MessageHub::read(Cursor &cursor, std::vector<unsigned char> &message, double &time, uint64_t &lost) const
+{
+    lost = 0;
+
+    for (;;)
+    {
+        if (cursor.position == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        uint64_t oldest = tail.load(std::memory_order_acquire);
+        if (cursor.position < oldest)
+        {
+            // Lapped, the count of what was lost comes from the next record read
+            cursor.position = oldest;
+            continue;
+        }
+
+        Record record;
+        copy(cursor.position, &record, sizeof(record));
+        bool plausible = record.length <= capacity - sizeof(Record);
+        if (plausible)
+        {
+            message.resize(record.length);
+            copy(cursor.position + sizeof(record), message.data(), record.length);
+        }
+
+        // Anything the writer moved tail past while we copied may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (tail.load(std::memory_order_relaxed) > cursor.position)
+        {
+            continue;
+        }
+        if (!plausible)
+        {
+            // Can only come from a torn copy, but never loop on it
+            cursor.position = head.load(std::memory_order_acquire);
+            return false;
+        }
+
+        lost = record.sequence - cursor.sequence;
+        cursor.sequence = record.sequence + 1;
+        cursor.position += alignRecord(sizeof(Record) + record.length);
+        time = record.time;
+        return true;
+    }
+}
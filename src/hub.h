@@ -0,0 +1,84 @@
+#ifndef NODE_MIDI_HUB_H
+#define NODE_MIDI_HUB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A named ring that inputs publish their messages into and any number of
+// subscribers read from, each through its own cursor. Hubs are shared by
+// the whole process, so subscribers can be in any worker. Readers never
+// take a lock or hold up the writer: one that falls a whole ring behind is
+// moved on to the oldest message still held and told how many it lost.
+//
+// The ring uses the same scheme as the flight recorder: records are 8-byte
+// aligned and may wrap, and head and tail are byte offsets which only ever
+// grow. The writer moves tail past a record before overwriting it, so a
+// reader which finds tail beyond its cursor after copying knows the copy
+// may be torn.
+class MessageHub
+{
+public:
+    using Notify = std::function<void()>;
+
+    struct Cursor
+    {
+        uint64_t position = 0;
+        // Sequence number of the next record expected
+        uint64_t sequence = 0;
+    };
+
+    // Finds the hub with this name, creating it with the given capacity in
+    // bytes if nobody holds it yet
+    static std::shared_ptr<MessageHub> get(const std::string &name, size_t capacity);
+
+    explicit MessageHub(size_t capacity);
+
+    void publish(const unsigned char *message, size_t length, double time);
+
+    // Returns a cursor at the newest message, and calls notify from the
+    // writer's thread whenever a message is published
+    Cursor subscribe(Notify notify, uint64_t &id);
+    void unsubscribe(uint64_t id);
+
+    // Copies out the message at the cursor and moves it on, returning false
+    // when there is nothing left to read. lost is set to the number of
+    // messages skipped because the reader fell behind.
+    bool read(Cursor &cursor, std::vector<unsigned char> &message, double &time, uint64_t &lost) const;
+
+    // Messages too large to ever fit in the ring
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Record
+    {
+        uint64_t sequence;
+        double time;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    void write(uint64_t offset, const void *data, size_t length);
+    void copy(uint64_t offset, void *data, size_t length) const;
+
+    const size_t capacity;
+    std::unique_ptr<unsigned char[]> ring;
+
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Taken by writers, and to change the subscribers
+    std::mutex mutex;
+    uint64_t sequence = 0;
+    uint64_t nextId = 0;
+    std::map<uint64_t, Notify> subscribers;
+};
+
+#endif // NODE_MIDI_HUB_H
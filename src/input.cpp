@@ -1,9 +1,16 @@
 #include <napi.h>
+#include <algorithm>
 #include <queue>
 
 #include "RtMidi.h"
 
 #include "input.h"
+#include "midi.h"
+#include "output.h"
+#include "ports.h"
+#include "probes.h"
+#include "recorder.h"
+#include "sequencer.h"
 
 const char *symbol_emit = "emit";
 const char *symbol_message = "message";
@@ -14,17 +21,39 @@ std::unique_ptr<Napi::FunctionReference> NodeMidiInput::Init(const Napi::Env &en
 
     Napi::Function func = DefineClass(env, "NodeMidiInput", {
                                                                 InstanceMethod<&NodeMidiInput::SetBufferSize>("setBufferSize", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::SetInputPool>("setInputPool", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::SetInputAutoGrow>("setInputAutoGrow", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
 
                                                                 InstanceMethod<&NodeMidiInput::GetPortCount>("getPortCount", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                 InstanceMethod<&NodeMidiInput::GetPortName>("getPortName", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
 
                                                                 InstanceMethod<&NodeMidiInput::OpenPort>("openPort", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                 InstanceMethod<&NodeMidiInput::OpenVirtualPort>("openVirtualPort", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::SwitchPort>("switchPort", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                 InstanceMethod<&NodeMidiInput::ClosePort>("closePort", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                 InstanceMethod<&NodeMidiInput::Destroy>("destroy", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                 InstanceMethod<&NodeMidiInput::IsPortOpen>("isPortOpen", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
 
                                                                 InstanceMethod<&NodeMidiInput::IgnoreTypes>("ignoreTypes", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::EnableUmp>("enableUmp", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::DisableUmp>("disableUmp", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::AssembleParameters>("assembleParameters", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::AssembleChords>("assembleChords", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::ThinControllers>("thinControllers", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::SetTransform>("setTransform", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::ClearTransform>("clearTransform", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::Publish>("publish", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::Unpublish>("unpublish", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::StartCapture>("startCapture", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::StopCapture>("stopCapture", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                InstanceMethod<&NodeMidiInput::Replay>("replay", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                InstanceMethod<&NodeMidiInput::GetStats>("getStats", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                             });
 
     // Create a persistent reference to the class constructor
@@ -35,339 +64,1393 @@ std::unique_ptr<Napi::FunctionReference> NodeMidiInput::Init(const Napi::Env &en
     return constructor;
 }
 
-static RtMidi::Api parseApi(const std::string &name)
+NodeMidiInput::NodeMidiInput(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeMidiInput>(info),
+      recorderPort(FlightRecorder::nextPort()),
+      timer([this](DeadlineTimer::Clock::time_point now) { return expireStages(now); })
+{
+    if (info.Length() == 0 || !info[0].IsFunction())
+    {
+        Napi::Error::New(info.Env(), "Expected a callback").ThrowAsJavaScriptException();
+        return;
+    }
+
+    if (info.Length() >= 2 && info[1].IsString())
+    {
+        api = parseApi(info[1].ToString().Utf8Value());
+    }
+
+    emitMessage = Napi::Persistent(info[0].As<Napi::Function>());
+}
+
+NodeMidiInput::~NodeMidiInput()
 {
-    if (name == "winmm") return RtMidi::WINDOWS_MM;
-    if (name == "uwp") return RtMidi::WINDOWS_UWP;
-    if (name == "core") return RtMidi::MACOSX_CORE;
-    if (name == "alsa") return RtMidi::LINUX_ALSA;
-    if (name == "jack") return RtMidi::UNIX_JACK;
-    return RtMidi::UNSPECIFIED;
+    timer.shutdown();
+    closePortAndRemoveCallback();
+    handle.reset();
+
+    // Calling into JS from a finalizer isn't safe, so requests still in
+    // flight are only let go of here. closePort() and destroy() reject them.
+    transactions.clear();
 }
 
-NodeMidiInput::NodeMidiInput(const Napi::CallbackInfo &info) : Napi::ObjectWrap<NodeMidiInput>(info)
+bool NodeMidiInput::ensureHandle(const Napi::Env &env)
 {
-    if (info.Length() == 0 || !info[0].IsFunction())
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (handle)
+    {
+        return true;
+    }
+
+    try
+    {
+        handle.reset(new RtMidiIn(api));
+
+        handle->setBufferSize(bufferSize, bufferCount);
+        handle->ignoreTypes(ignoreSysex, ignoreTiming, ignoreSensing);
+        if (inputPoolSize > 0 || inputPoolBufferSize > 0)
+        {
+            handle->setInputPool(inputPoolSize, inputPoolBufferSize);
+        }
+        handle->setInputAutoGrow(inputPoolLimit);
+        handle->setOverrunCallback(&NodeMidiInput::Overrun, this);
+
+        // A replay may have set the callback up before there was a client
+        if (configured)
+        {
+            handle->setCallback(&NodeMidiInput::Callback, this);
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        handle.reset();
+        Napi::Error::New(env, "Failed to initialise RtMidi").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
+}
+
+void NodeMidiInput::setupCallback(const Napi::Env &env)
+{
+    if (!configured)
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        configured = true;
+        callbackReleased = new bool(false);
+
+        handleMessage = TSFN_t::New(
+            env,
+            emitMessage.Value(),
+            "Midi Input",
+            0,
+            1,
+            this,
+            [](Napi::Env, bool *released, NodeMidiInput *ctx) { // Finalizer used to clean threads up
+                // This TSFN can be destroyed when the worker_thread is destroyed, well before the NodeMidiInput is.
+                // Once we released it ourselves, ctx may already be gone.
+                if (!*released)
+                {
+                    ctx->closePortAndRemoveCallback();
+                    ctx->transactions.clear();
+                }
+                delete released;
+            },
+            callbackReleased);
+
+        // Replaying needs no client, so there may not be one yet
+        if (handle)
+        {
+            handle->setCallback(&NodeMidiInput::Callback, this);
+        }
+    }
+}
+
+void NodeMidiInput::closePortAndRemoveCallback()
+{
+    // The replay thread calls into the stages, so must be gone before they are reset
+    stopReplay();
+
+    if (handle != nullptr)
+    {
+        handle->closePort();
+    }
+
+    if (configured)
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        configured = false;
+
+        // Anything still held by the stages belongs to the old connection
+        parameters.reset();
+        completedParameters.clear();
+        chords.reset();
+        completedChords.clear();
+        thinner.reset();
+        thinnedMessages.clear();
+        sysex.clear();
+        sysexOutcomes.clear();
+        capture.close();
+        streamTime = 0;
+        lastEmitTime = 0;
+
+        if (handle != nullptr)
+        {
+            handle->cancelCallback();
+        }
+        *callbackReleased = true;
+        handleMessage.Abort();
+        handleMessage.Release();
+        stats.clearQueue();
+    }
+}
+
+void NodeMidiInput::Callback(double deltaTime, std::vector<unsigned char> *message, void *userData)
+{
+    NodeMidiInput *input = static_cast<NodeMidiInput *>(userData);
+
+    input->stats.received(message->data(), message->size());
+    NODE_MIDI_PROBE(input_enqueue, input->recorderPort, message->size(), nodeMidiProbeTime());
+    FlightRecorder::instance().record(input->recorderPort, FlightRecorder::In, message->data(), message->size());
+
+    std::lock_guard<std::mutex> lock(input->pipelineMutex);
+
+    input->streamTime += deltaTime;
+    double time = input->streamTime;
+
+    if (input->capture.isOpen())
+    {
+        input->capture.write(static_cast<uint64_t>((time - input->captureStart) * 1e9), input->recorderPort, message->data(), message->size());
+    }
+
+    if (input->hub)
+    {
+        input->hub->publish(message->data(), message->size(), time);
+    }
+
+    for (NodeMidiSequencer *follower : input->followers)
+    {
+        follower->played(message->data(), message->size());
+    }
+
+    if (input->transform.isLoaded() && message->size() > 0 && message->size() <= 3)
+    {
+        input->transformed.clear();
+        input->transform.run(message->data(), message->size(), input->transformed);
+        for (const TransformVm::Emitted &emitted : input->transformed)
+        {
+            if (emitted.target == 0)
+            {
+                input->process(emitted.bytes, emitted.length, time);
+            }
+            else
+            {
+                input->transformTargets[emitted.target - 1]->sendRaw(emitted.bytes, emitted.length);
+            }
+        }
+        return;
+    }
+
+    input->process(message->data(), message->size(), time);
+}
+
+void NodeMidiInput::process(const unsigned char *message, size_t length, double time)
+{
+    if (!sysex.isEmpty() && length > 0 && message[0] == 0xF0)
+    {
+        if (sysex.process(message, length, DeadlineTimer::Clock::now(), sysexOutcomes))
+        {
+            // A handshake may have moved a deadline earlier, so let the
+            // timer work out the next one
+            timer.schedule(DeadlineTimer::Clock::now());
+            emitOutcomes(time);
+            return;
+        }
+    }
+
+    if (chords.isEnabled())
+    {
+        DeadlineTimer::Clock::time_point now = DeadlineTimer::Clock::now();
+        bool consumed = chords.process(message, length, time, now, completedChords);
+        emitChords();
+        if (consumed)
+        {
+            timer.schedule(now + chords.getOptions().window);
+            return;
+        }
+    }
+
+    if (parameters.isEnabled())
+    {
+        DeadlineTimer::Clock::time_point now = DeadlineTimer::Clock::now();
+        if (parameters.process(message, length, time, now, completedParameters))
+        {
+            emitParameters();
+            timer.schedule(now + parameters.getOptions().timeout);
+            return;
+        }
+    }
+
+    if (thinner.isEnabled())
+    {
+        DeadlineTimer::Clock::time_point deadline = DeadlineTimer::Clock::time_point::max();
+        if (thinner.process(message, length, time, DeadlineTimer::Clock::now(), deadline))
+        {
+            stats.add(PortStats::Thinned);
+            timer.schedule(deadline);
+            return;
+        }
+    }
+
+    emitMidi(message, length, time);
+}
+
+void NodeMidiInput::Overrun(const RtMidiIn::InputOverrun &overrun, void *userData)
+{
+    NodeMidiInput *input = static_cast<NodeMidiInput *>(userData);
+
+    input->stats.add(PortStats::Overruns);
+
+    std::lock_guard<std::mutex> lock(input->pipelineMutex);
+    if (input->configured)
+    {
+        MidiMessage *data = new MidiMessage();
+        data->type = EventType::Overrun;
+        data->overruns = overrun.overruns;
+        data->poolSize = overrun.poolSize;
+        input->dispatch(data, input->streamTime);
+    }
+}
+
+void NodeMidiInput::replay(std::vector<CaptureEvent> events, bool realtime)
+{
+    DeadlineTimer::Clock::time_point start = DeadlineTimer::Clock::now();
+    uint64_t first = events.empty() ? 0 : events.front().time;
+    uint64_t previous = first;
+
+    for (CaptureEvent &event : events)
+    {
+        if (realtime)
+        {
+            // Sleep in short steps, so stopping doesn't wait out a long gap
+            DeadlineTimer::Clock::time_point due = start + std::chrono::nanoseconds(event.time - first);
+            while (!replayStopping && DeadlineTimer::Clock::now() < due)
+            {
+                std::this_thread::sleep_until(std::min(due, DeadlineTimer::Clock::now() + std::chrono::milliseconds(50)));
+            }
+        }
+
+        if (replayStopping)
+        {
+            replaying = false;
+            return;
+        }
+
+        Callback((event.time - previous) / 1e9, &event.message, this);
+        previous = event.time;
+    }
+
+    // Closed by the time 'end' is handled
+    replaying = false;
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    if (configured)
+    {
+        MidiMessage *data = new MidiMessage();
+        data->type = EventType::End;
+        dispatch(data, streamTime);
+    }
+}
+
+void NodeMidiInput::stopReplay()
+{
+    if (replayThread.joinable())
+    {
+        replayStopping = true;
+        replayThread.join();
+        replayStopping = false;
+    }
+}
+
+void NodeMidiInput::emitMidi(const unsigned char *message, size_t length, double time)
+{
+    MidiMessage *data = new MidiMessage();
+
+    int mode = umpMode.load(std::memory_order_relaxed);
+    if (mode != 0)
+    {
+        std::vector<uint32_t> words;
+        if (!Ump::fromMidi1(message, length, static_cast<Ump::Protocol>(mode & 0x0F), mode >> 4, words))
+        {
+            stats.add(PortStats::DroppedConversion);
+            delete data;
+            return;
+        }
+
+        data->type = EventType::Ump;
+        data->umpLength = words.size();
+        data->ump = new uint32_t[data->umpLength];
+        memcpy(data->ump, words.data(), data->umpLength * sizeof(uint32_t));
+    }
+    else
+    {
+        data->type = EventType::Message;
+        data->messageLength = length;
+        data->message = new unsigned char[data->messageLength];
+        memcpy(data->message, message, data->messageLength * sizeof(unsigned char));
+    }
+
+    dispatch(data, time);
+}
+
+void NodeMidiInput::emitParameters()
+{
+    for (const ParameterAssembler::Parameter &parameter : completedParameters)
+    {
+        MidiMessage *data = new MidiMessage();
+        switch (parameter.kind)
+        {
+        case ParameterAssembler::CC14:
+            data->type = EventType::Cc14;
+            break;
+        case ParameterAssembler::RPN:
+            data->type = EventType::Rpn;
+            break;
+        case ParameterAssembler::NRPN:
+            data->type = EventType::Nrpn;
+            break;
+        }
+        data->channel = parameter.channel;
+        data->param = parameter.param;
+        data->value = parameter.value;
+
+        dispatch(data, parameter.time);
+    }
+
+    completedParameters.clear();
+}
+
+void NodeMidiInput::emitChords()
+{
+    for (const ChordAssembler::Chord &chord : completedChords)
+    {
+        // A lone note goes out as the message it came in as
+        if (chord.notes.size() == 1)
+        {
+            unsigned char message[3] = {chord.status, chord.notes[0], chord.velocities[0]};
+            emitMidi(message, 3, chord.time);
+            continue;
+        }
+
+        MidiMessage *data = new MidiMessage();
+        data->type = EventType::Chord;
+        data->channel = chord.channel;
+        data->value = chord.on;
+        // The notes followed by their velocities
+        data->messageLength = chord.notes.size() * 2;
+        data->message = new unsigned char[data->messageLength];
+        memcpy(data->message, chord.notes.data(), chord.notes.size());
+        memcpy(data->message + chord.notes.size(), chord.velocities.data(), chord.velocities.size());
+
+        dispatch(data, chord.time);
+    }
+
+    completedChords.clear();
+}
+
+void NodeMidiInput::emitThinned()
+{
+    for (const ControllerThinner::Message &message : thinnedMessages)
+    {
+        emitMidi(message.bytes, message.length, message.time);
+    }
+
+    thinnedMessages.clear();
+}
+
+void NodeMidiInput::emitOutcomes(double time)
+{
+    for (SysexMatcher::Outcome &outcome : sysexOutcomes)
+    {
+        MidiMessage *data = new MidiMessage();
+        data->type = EventType::Transaction;
+        data->request = outcome.id;
+        data->outcome = outcome.type;
+        if (!outcome.message.empty())
+        {
+            data->messageLength = outcome.message.size();
+            data->message = new unsigned char[data->messageLength];
+            memcpy(data->message, outcome.message.data(), data->messageLength * sizeof(unsigned char));
+        }
+
+        dispatch(data, time);
+    }
+
+    sysexOutcomes.clear();
+}
+
+void NodeMidiInput::dispatch(MidiMessage *data, double time)
+{
+    // Events held back by a stage can complete after later ones were emitted
+    data->deltaTime = time > lastEmitTime ? time - lastEmitTime : 0;
+    if (time > lastEmitTime)
+    {
+        lastEmitTime = time;
+    }
+
+    if (NODE_MIDI_PROBE_ENABLED(input_dispatch))
+    {
+        data->queuedAt = nodeMidiProbeTime();
+    }
+
+    // Forward to CallbackJs
+    stats.enqueued();
+    if (handleMessage.NonBlockingCall(data) != napi_ok)
+    {
+        stats.rejected();
+        freeMessage(data);
+    }
+}
+
+DeadlineTimer::Clock::time_point NodeMidiInput::expireStages(DeadlineTimer::Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+
+    if (!configured)
+    {
+        return DeadlineTimer::Clock::time_point::max();
+    }
+
+    DeadlineTimer::Clock::time_point next = parameters.expire(now, completedParameters);
+    emitParameters();
+
+    DeadlineTimer::Clock::time_point requests = sysex.expire(now, sysexOutcomes);
+    emitOutcomes(streamTime);
+
+    DeadlineTimer::Clock::time_point chord = chords.expire(now, completedChords);
+    emitChords();
+
+    DeadlineTimer::Clock::time_point thinned = thinner.expire(now, thinnedMessages);
+    emitThinned();
+
+    return std::min({next, requests, chord, thinned});
+}
+
+void NodeMidiInput::freeMessage(MidiMessage *data)
+{
+    if (data->message != nullptr)
+    {
+        delete[] data->message;
+    }
+
+    if (data->ump != nullptr)
+    {
+        delete[] data->ump;
+    }
+
+    delete data;
+}
+
+void NodeMidiInput::CallbackJs(Napi::Env env, Napi::Function callback, NodeMidiInput *context, MidiMessage *data)
+{
+    if (env != nullptr && callback != nullptr)
+    {
+        context->stats.dequeued();
+        NODE_MIDI_PROBE(input_dispatch, context->recorderPort, data->type == EventType::Ump ? data->umpLength * sizeof(uint32_t) : data->messageLength, nodeMidiProbeTime(), data->queuedAt);
+
+        Napi::Value deltaTime = Napi::Number::New(env, data->deltaTime);
+
+        switch (data->type)
+        {
+        case EventType::Message:
+        {
+            Napi::Value message = Napi::Buffer<unsigned char>::Copy(env, data->message, data->messageLength);
+
+            callback.Call({deltaTime, message});
+            break;
+        }
+        case EventType::Ump:
+        {
+            Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, data->umpLength * sizeof(uint32_t));
+            memcpy(buffer.Data(), data->ump, data->umpLength * sizeof(uint32_t));
+            Napi::Value words = Napi::Uint32Array::New(env, data->umpLength, buffer, 0);
+
+            callback.Call({deltaTime, words, Napi::String::New(env, "ump")});
+            break;
+        }
+        case EventType::Cc14:
+        case EventType::Rpn:
+        case EventType::Nrpn:
+        {
+            const char *type = data->type == EventType::Cc14 ? "cc14" : data->type == EventType::Rpn ? "rpn" : "nrpn";
+
+            Napi::Object parameter = Napi::Object::New(env);
+            parameter.Set("channel", Napi::Number::New(env, data->channel));
+            parameter.Set("param", Napi::Number::New(env, data->param));
+            parameter.Set("value", Napi::Number::New(env, data->value));
+
+            callback.Call({deltaTime, parameter, Napi::String::New(env, type)});
+            break;
+        }
+        case EventType::Chord:
+        {
+            size_t count = data->messageLength / 2;
+            Napi::Array notes = Napi::Array::New(env, count);
+            Napi::Array velocities = Napi::Array::New(env, count);
+            for (size_t i = 0; i < count; i++)
+            {
+                notes.Set(static_cast<uint32_t>(i), Napi::Number::New(env, data->message[i]));
+                velocities.Set(static_cast<uint32_t>(i), Napi::Number::New(env, data->message[count + i]));
+            }
+
+            Napi::Object chord = Napi::Object::New(env);
+            chord.Set("channel", Napi::Number::New(env, data->channel));
+            chord.Set("on", Napi::Boolean::New(env, data->value != 0));
+            chord.Set("notes", notes);
+            chord.Set("velocities", velocities);
+
+            callback.Call({deltaTime, chord, Napi::String::New(env, "chord")});
+            break;
+        }
+        case EventType::Transaction:
+            context->settleRequest(env, data);
+            break;
+        case EventType::Overrun:
+        {
+            Napi::Object overrun = Napi::Object::New(env);
+            overrun.Set("overruns", Napi::Number::New(env, static_cast<double>(data->overruns)));
+            overrun.Set("poolSize", Napi::Number::New(env, data->poolSize));
+
+            callback.Call({deltaTime, overrun, Napi::String::New(env, "overrun")});
+            break;
+        }
+        case EventType::End:
+            callback.Call({deltaTime, env.Undefined(), Napi::String::New(env, "end")});
+            break;
+        }
+    }
+
+    if (data != nullptr)
+    {
+        // We're finished with the data.
+        freeMessage(data);
+    }
+}
+
+Napi::Value NodeMidiInput::beginRequest(const Napi::Env &env, SysexMatcher::Request request, Napi::Object output, uint32_t &id)
+{
+    DeadlineTimer::Clock::time_point deadline;
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+
+        if (!configured)
+        {
+            Napi::Error::New(env, "Input port is not open").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        DeadlineTimer::Clock::time_point now = DeadlineTimer::Clock::now();
+        deadline = now + request.timeout;
+
+        id = nextRequest++;
+        sysex.add(id, std::move(request), now);
+    }
+
+    timer.schedule(deadline);
+
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    transactions.emplace(id, Transaction{deferred, Napi::Persistent(output)});
+
+    return deferred.Promise();
+}
+
+void NodeMidiInput::failRequest(const Napi::Env &env, uint32_t id, const char *reason)
+{
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        sysex.remove(id);
+    }
+
+    auto found = transactions.find(id);
+    if (found != transactions.end())
+    {
+        found->second.deferred.Reject(Napi::Error::New(env, reason).Value());
+        transactions.erase(found);
+    }
+}
+
+void NodeMidiInput::follow(NodeMidiSequencer *sequencer)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    followers.push_back(sequencer);
+}
+
+void NodeMidiInput::unfollow(NodeMidiSequencer *sequencer)
+{
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    followers.erase(std::remove(followers.begin(), followers.end(), sequencer), followers.end());
+}
+
+void NodeMidiInput::settleRequest(const Napi::Env &env, MidiMessage *data)
+{
+    auto found = transactions.find(data->request);
+    if (found == transactions.end())
+    {
+        return;
+    }
+
+    Napi::Promise::Deferred deferred = found->second.deferred;
+    transactions.erase(found);
+
+    switch (data->outcome)
+    {
+    case SysexMatcher::Outcome::Response:
+        deferred.Resolve(Napi::Buffer<unsigned char>::Copy(env, data->message, data->messageLength));
+        break;
+    case SysexMatcher::Outcome::Timeout:
+        deferred.Reject(Napi::Error::New(env, "Request timed out").Value());
+        break;
+    case SysexMatcher::Outcome::Rejected:
+        deferred.Reject(Napi::Error::New(env, "Request rejected by device").Value());
+        break;
+    case SysexMatcher::Outcome::Cancelled:
+        deferred.Reject(Napi::Error::New(env, "Request cancelled by device").Value());
+        break;
+    }
+}
+
+void NodeMidiInput::rejectRequests(const Napi::Env &env)
+{
+    // The matcher was cleared with the port, so no outcome can still arrive for these
+    std::map<uint32_t, Transaction> abandoned;
+    abandoned.swap(transactions);
+
+    for (auto &transaction : abandoned)
+    {
+        transaction.second.deferred.Reject(Napi::Error::New(env, "Input port closed").Value());
+    }
+}
+
+Napi::Value NodeMidiInput::SetBufferSize(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int size = info[0].ToNumber();
+    unsigned int count = info[1].ToNumber();
+
+    bufferSize = size;
+    bufferCount = count;
+    if (!handle)
+    {
+        return env.Null();
+    }
+
+    try
+    {
+        handle->setBufferSize(size, count);
+    }
+    catch (RtMidiError &e)
+    {
+        handle.reset();
+        Napi::Error::New(info.Env(), "Failed to set buffer size").ThrowAsJavaScriptException();
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::SetInputPool(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int pool = info[0].ToNumber();
+    unsigned int buffer = info[1].ToNumber();
+
+    // Kept for a handle created later, where zero leaves a setting alone
+    if (pool > 0)
+    {
+        inputPoolSize = pool;
+    }
+    if (buffer > 0)
+    {
+        inputPoolBufferSize = buffer;
+    }
+
+    if (handle)
+    {
+        handle->setInputPool(pool, buffer);
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::SetInputAutoGrow(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    inputPoolLimit = info[0].ToNumber();
+    if (handle)
+    {
+        handle->setInputAutoGrow(inputPoolLimit);
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::GetPortCount(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    try
+    {
+        return Napi::Number::New(env, handle ? handle->getPortCount() : PortEnumerator::inputCount(api));
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Failed to initialise RtMidi").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+Napi::Value NodeMidiInput::GetPortName(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int portNumber = info[0].ToNumber();
+    try
+    {
+        return Napi::String::New(env, handle ? handle->getPortName(portNumber) : PortEnumerator::inputName(api, portNumber));
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::TypeError::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+Napi::Value NodeMidiInput::OpenPort(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (!ensureHandle(env))
+    {
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int portNumber = info[0].ToNumber();
+    if (portNumber >= handle->getPortCount())
+    {
+        Napi::RangeError::New(env, "Invalid MIDI port number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    try
+    {
+        setupCallback(env);
+        handle->openPort(portNumber);
+
+        FlightRecorder &recorder = FlightRecorder::instance();
+        if (recorder.isOpen())
+        {
+            recorder.record(recorderPort, FlightRecorder::OpenIn, handle->getPortName(portNumber));
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::OpenVirtualPort(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (!ensureHandle(env))
+    {
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "First argument must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string name = info[0].ToString();
+
+    try
+    {
+        setupCallback(env);
+        handle->openVirtualPort(name);
+        FlightRecorder::instance().record(recorderPort, FlightRecorder::OpenIn, name);
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::SwitchPort(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (!ensureHandle(env))
+    {
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int portNumber = info[0].ToNumber();
+    if (portNumber >= handle->getPortCount())
     {
-        Napi::Error::New(info.Env(), "Expected a callback").ThrowAsJavaScriptException();
-        return;
+        Napi::RangeError::New(env, "Invalid MIDI port number").ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    RtMidi::Api api = RtMidi::UNSPECIFIED;
-    if (info.Length() >= 2 && info[1].IsString())
+    if (replayThread.joinable())
     {
-        api = parseApi(info[1].ToString().Utf8Value());
+        Napi::Error::New(env, "Cannot switch a replay").ThrowAsJavaScriptException();
+        return env.Null();
     }
 
+    // The TSFN, the stages and any outstanding requests are kept, only the
+    // connection moves
     try
     {
-        handle.reset(new RtMidiIn(api));
+        setupCallback(env);
+        handle->switchPort(portNumber);
 
-        handle->setBufferSize(2048, 4);
+        FlightRecorder &recorder = FlightRecorder::instance();
+        if (recorder.isOpen())
+        {
+            recorder.record(recorderPort, FlightRecorder::OpenIn, handle->getPortName(portNumber));
+        }
     }
     catch (RtMidiError &e)
     {
-        handle.reset();
-        Napi::Error::New(info.Env(), "Failed to initialise RtMidi").ThrowAsJavaScriptException();
-        return;
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    emitMessage = Napi::Persistent(info[0].As<Napi::Function>());
-}
+    // A half sent parameter or chord from the old device must not combine with the new one's
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    parameters.reset();
+    chords.reset();
+    thinner.reset();
 
-NodeMidiInput::~NodeMidiInput()
-{
-    closePortAndRemoveCallback();
-    handle.reset();
+    return env.Null();
 }
 
-void NodeMidiInput::setupCallback(const Napi::Env &env)
+Napi::Value NodeMidiInput::ClosePort(const Napi::CallbackInfo &info)
 {
-    if (!configured)
-    {
-        configured = true;
-
-        handleMessage = TSFN_t::New(
-            env,
-            emitMessage.Value(),
-            "Midi Input",
-            0,
-            1,
-            this,
-            [](Napi::Env, void *, NodeMidiInput *ctx) { // Finalizer used to clean threads up
-                // This TSFN can be destroyed when the worker_thread is destroyed, well before the NodeMidiInput is.
-                ctx->closePortAndRemoveCallback();
-            });
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
 
-        handle->setCallback(&NodeMidiInput::Callback, this);
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
     }
+
+    closePortAndRemoveCallback();
+    rejectRequests(env);
+    return env.Null();
 }
 
-void NodeMidiInput::closePortAndRemoveCallback()
+Napi::Value NodeMidiInput::Destroy(const Napi::CallbackInfo &info)
 {
-    if (handle != nullptr)
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
     {
-        handle->closePort();
+        return env.Null();
+    }
 
-        if (configured)
-        {
-            configured = false;
+    closePortAndRemoveCallback();
+    rejectRequests(env);
+    ClearTransform(info);
+    handle.reset();
+    destroyed = true;
 
-            handle->cancelCallback();
-            handleMessage.Abort();
-            handleMessage.Release();
-        }
-    }
+    return env.Null();
 }
 
-void NodeMidiInput::Callback(double deltaTime, std::vector<unsigned char> *message, void *userData)
+Napi::Value NodeMidiInput::IsPortOpen(const Napi::CallbackInfo &info)
 {
-    NodeMidiInput *input = static_cast<NodeMidiInput *>(userData);
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
 
-    MidiMessage *data = new MidiMessage();
-    data->deltaTime = deltaTime;
-    data->messageLength = message->size();
-    data->message = new unsigned char[data->messageLength];
-    memcpy(data->message, message->data(), data->messageLength * sizeof(unsigned char));
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-    // Forward to CallbackJs
-    input->handleMessage.NonBlockingCall(data);
+    return Napi::Boolean::New(env, (handle && handle->isPortOpen()) || replaying);
 }
 
-void NodeMidiInput::CallbackJs(Napi::Env env, Napi::Function callback, NodeMidiInput *context, MidiMessage *data)
+Napi::Value NodeMidiInput::IgnoreTypes(const Napi::CallbackInfo &info)
 {
-    if (env != nullptr && callback != nullptr)
-    {
-        Napi::Value deltaTime = Napi::Number::New(env, data->deltaTime);
-
-        Napi::Value message = Napi::Buffer<unsigned char>::Copy(env, data->message, data->messageLength);
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
 
-        callback.Call({deltaTime, message});
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    if (data != nullptr)
+    if (info.Length() != 3 || !info[0].IsBoolean() || !info[1].IsBoolean() || !info[2].IsBoolean())
     {
-        if (data->message != nullptr)
-        {
-            delete[] data->message;
-        }
+        Napi::TypeError::New(env, "Arguments must be boolean").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-        // We're finished with the data.
-        delete data;
+    ignoreSysex = info[0].ToBoolean();
+    ignoreTiming = info[1].ToBoolean();
+    ignoreSensing = info[2].ToBoolean();
+    if (handle)
+    {
+        handle->ignoreTypes(ignoreSysex, ignoreTiming, ignoreSensing);
     }
+
+    return env.Null();
 }
 
-Napi::Value NodeMidiInput::SetBufferSize(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::EnableUmp(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    int protocol = info[0].ToNumber();
+    int group = info[1].ToNumber();
+    if ((protocol != Ump::MIDI1 && protocol != Ump::MIDI2) || group < 0 || group > 15)
     {
-        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
+        Napi::RangeError::New(env, "Invalid UMP protocol or group").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    unsigned int size = info[0].ToNumber();
-    unsigned int count = info[1].ToNumber();
+    umpMode = protocol | (group << 4);
 
-    try
-    {
-        handle->setBufferSize(size, count);
-    }
-    catch (RtMidiError &e)
-    {
-        handle.reset();
-        Napi::Error::New(info.Env(), "Failed to set buffer size").ThrowAsJavaScriptException();
-    }
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::DisableUmp(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    umpMode = 0;
 
     return env.Null();
 }
 
-Napi::Value NodeMidiInput::GetPortCount(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::AssembleParameters(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() != 4 || !info[0].IsBoolean() || !info[1].IsBoolean() || !info[2].IsBoolean() || !info[3].IsNumber())
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected three booleans and a timeout").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double timeout = info[3].ToNumber();
+    if (!(timeout >= 0))
+    {
+        Napi::RangeError::New(env, "Timeout must not be negative").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    return Napi::Number::New(env, handle->getPortCount());
+    ParameterAssembler::Options options;
+    options.cc14 = info[0].ToBoolean();
+    options.rpn = info[1].ToBoolean();
+    options.nrpn = info[2].ToBoolean();
+    options.timeout = std::chrono::duration_cast<DeadlineTimer::Clock::duration>(std::chrono::duration<double, std::milli>(timeout));
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    parameters.configure(options);
+    completedParameters.clear();
+
+    return env.Null();
 }
 
-Napi::Value NodeMidiInput::GetPortName(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::AssembleChords(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() != 3 || !info[0].IsBoolean() || !info[1].IsBoolean() || !info[2].IsNumber())
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected two booleans and a window").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (info.Length() == 0 || !info[0].IsNumber())
+    double window = info[2].ToNumber();
+    if (!(window > 0))
     {
-        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
+        Napi::RangeError::New(env, "Window must be positive").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    unsigned int portNumber = info[0].ToNumber();
-    try
+    ChordAssembler::Options options;
+    options.noteOns = info[0].ToBoolean();
+    options.noteOffs = info[1].ToBoolean();
+    options.window = std::chrono::duration_cast<DeadlineTimer::Clock::duration>(std::chrono::duration<double, std::milli>(window));
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    chords.configure(options);
+    completedChords.clear();
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::ThinControllers(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() != 1 || !info[0].IsArray())
     {
-        return Napi::String::New(env, handle->getPortName(portNumber));
+        Napi::TypeError::New(env, "First argument must be an array of rules").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    catch (RtMidiError &e)
+
+    Napi::Array array = info[0].As<Napi::Array>();
+    std::vector<ControllerThinner::Rule> rules;
+    for (uint32_t i = 0; i < array.Length(); i++)
     {
-        Napi::TypeError::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
-        return env.Null();
+        Napi::Value value = array.Get(i);
+        if (!value.IsObject())
+        {
+            Napi::TypeError::New(env, "Rules must be objects").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object object = value.As<Napi::Object>();
+        double channel = object.Get("channel").ToNumber();
+        double controller = object.Get("controller").ToNumber();
+        double deadband = object.Get("deadband").ToNumber();
+        double hysteresis = object.Get("hysteresis").ToNumber();
+        double rate = object.Get("rate").ToNumber();
+        if (!(channel >= -1 && channel <= 15) || !(controller >= -1 && controller < ControllerThinner::Controllers) ||
+            !(deadband >= 0 && deadband <= 16383) || !(hysteresis >= 0 && hysteresis <= 16383) || !(rate >= 0))
+        {
+            Napi::RangeError::New(env, "Invalid thinning rule").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ControllerThinner::Rule rule;
+        rule.channel = static_cast<int>(channel);
+        rule.controller = static_cast<int>(controller);
+        rule.deadband = static_cast<unsigned int>(deadband);
+        rule.hysteresis = static_cast<unsigned int>(hysteresis);
+        if (rate > 0)
+        {
+            rule.interval = std::chrono::duration_cast<DeadlineTimer::Clock::duration>(std::chrono::duration<double>(1 / rate));
+        }
+        rules.push_back(rule);
     }
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    thinner.configure(rules);
+    thinnedMessages.clear();
+
+    return env.Null();
 }
 
-Napi::Value NodeMidiInput::OpenPort(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::SetTransform(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() != 3 || !info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array || !info[1].IsArray() || !info[2].IsArray())
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected a Uint32Array, an array of tables and an array of outputs").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (info.Length() == 0 || !info[0].IsNumber())
+    Napi::Uint32Array program = info[0].As<Napi::Uint32Array>();
+    std::vector<uint32_t> code(program.Data(), program.Data() + program.ElementLength());
+
+    Napi::Array tableArray = info[1].As<Napi::Array>();
+    std::vector<std::vector<int32_t>> tables;
+    for (uint32_t i = 0; i < tableArray.Length(); i++)
     {
-        Napi::TypeError::New(env, "First argument must be an integer").ThrowAsJavaScriptException();
-        return env.Null();
+        Napi::Value table = tableArray.Get(i);
+        if (!table.IsTypedArray() || table.As<Napi::TypedArray>().TypedArrayType() != napi_int32_array)
+        {
+            Napi::TypeError::New(env, "Lookup tables must be Int32Arrays").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        Napi::Int32Array values = table.As<Napi::Int32Array>();
+        tables.emplace_back(values.Data(), values.Data() + values.ElementLength());
     }
 
-    unsigned int portNumber = info[0].ToNumber();
-    if (portNumber >= handle->getPortCount())
+    MidiInstanceData *instanceData = env.GetInstanceData<MidiInstanceData>();
+    Napi::Array outputArray = info[2].As<Napi::Array>();
+    std::vector<NodeMidiOutput *> targets;
+    std::vector<Napi::ObjectReference> outputs;
+    for (uint32_t i = 0; i < outputArray.Length(); i++)
     {
-        Napi::RangeError::New(env, "Invalid MIDI port number").ThrowAsJavaScriptException();
+        Napi::Value output = outputArray.Get(i);
+        if (!output.IsObject() || !output.As<Napi::Object>().InstanceOf(instanceData->output->Value()))
+        {
+            Napi::TypeError::New(env, "Transform targets must be outputs").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        targets.push_back(NodeMidiOutput::Unwrap(output.As<Napi::Object>()));
+        outputs.push_back(Napi::Persistent(output.As<Napi::Object>()));
+    }
+
+    TransformVm vm;
+    std::string error;
+    if (!vm.load(std::move(code), std::move(tables), targets.size(), error))
+    {
+        Napi::RangeError::New(env, error).ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    try
     {
-        setupCallback(env);
-        handle->openPort(portNumber);
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        std::swap(transform, vm);
+        std::swap(transformTargets, targets);
     }
-    catch (RtMidiError &e)
+    // The old outputs are released once nothing can send through them
+    std::swap(transformOutputs, outputs);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiInput::ClearTransform(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
     {
-        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        transform.clear();
+        transformTargets.clear();
     }
+    transformOutputs.clear();
 
     return env.Null();
 }
 
-Napi::Value NodeMidiInput::OpenVirtualPort(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::Publish(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber())
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected a hub name and a capacity").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (info.Length() == 0 || !info[0].IsString())
+    double capacity = info[1].ToNumber();
+    if (!(capacity > 0))
     {
-        Napi::TypeError::New(env, "First argument must be a string").ThrowAsJavaScriptException();
+        Napi::RangeError::New(env, "Capacity must be positive").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    std::string name = info[0].ToString();
+    std::shared_ptr<MessageHub> found = MessageHub::get(info[0].ToString().Utf8Value(), static_cast<size_t>(capacity));
 
-    try
-    {
-        setupCallback(env);
-        handle->openVirtualPort(name);
-    }
-    catch (RtMidiError &e)
-    {
-        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
-    }
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    hub = std::move(found);
 
     return env.Null();
 }
 
-Napi::Value NodeMidiInput::ClosePort(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::Unpublish(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
-    {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
-        return env.Null();
-    }
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    hub.reset();
 
-    closePortAndRemoveCallback();
     return env.Null();
 }
 
-Napi::Value NodeMidiInput::Destroy(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::StartCapture(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (info.Length() == 0 || !info[0].IsString())
     {
+        Napi::TypeError::New(env, "First argument must be a string").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    closePortAndRemoveCallback();
-    handle.reset();
+    std::string path = info[0].ToString();
+
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+
+    if (!capture.open(path))
+    {
+        Napi::Error::New(env, "Failed to open capture file").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    captureStart = streamTime;
 
     return env.Null();
 }
 
-Napi::Value NodeMidiInput::IsPortOpen(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::StopCapture(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
-    {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
-        return env.Null();
-    }
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    capture.close();
 
-    return Napi::Boolean::New(env, handle->isPortOpen());
+    return env.Null();
 }
 
-Napi::Value NodeMidiInput::IgnoreTypes(const Napi::CallbackInfo &info)
+Napi::Value NodeMidiInput::Replay(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    // Replaying feeds the stages directly, so no client is created for it
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (info.Length() != 3 || !info[0].IsBoolean() || !info[1].IsBoolean() || !info[2].IsBoolean())
+    if (info.Length() != 2 || !info[0].IsString() || !info[1].IsBoolean())
     {
-        Napi::TypeError::New(env, "Arguments must be boolean").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected a path and a boolean").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if ((handle && handle->isPortOpen()) || replaying)
+    {
+        Napi::Error::New(env, "Port is already open").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // A replay which already finished still has its thread to reap
+    stopReplay();
+
+    std::vector<CaptureEvent> events;
+    if (!readCapture(info[0].ToString(), events))
+    {
+        Napi::Error::New(env, "Failed to read capture file").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    bool filter_sysex = info[0].ToBoolean();
-    bool filter_timing = info[1].ToBoolean();
-    bool filter_sensing = info[2].ToBoolean();
-    handle->ignoreTypes(filter_sysex, filter_timing, filter_sensing);
+    setupCallback(env);
+    replaying = true;
+    replayThread = std::thread(&NodeMidiInput::replay, this, std::move(events), info[1].ToBoolean().Value());
 
     return env.Null();
 }
+
+Napi::Value NodeMidiInput::GetStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    Napi::Object result = stats.toObject(env);
+
+    // Kept by the driver, so only known once a client exists
+    result.Set("inputPool", Napi::Number::New(env, handle ? handle->getInputPool() : 0));
+
+    return result;
+}
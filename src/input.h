@@ -2,32 +2,174 @@
 #define NODE_MIDI_INPUT_H
 
 #include <napi.h>
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <queue>
+#include <thread>
 
 #include "RtMidi.h"
+#include "capture.h"
+#include "chords.h"
+#include "hub.h"
+#include "params.h"
+#include "stats.h"
+#include "sysex.h"
+#include "thinning.h"
+#include "timer.h"
+#include "transform.h"
+#include "ump.h"
+
+class NodeMidiOutput;
+class NodeMidiSequencer;
 
 class NodeMidiInput : public Napi::ObjectWrap<NodeMidiInput>
 {
 private:
+    enum class EventType
+    {
+        Message,
+        Ump,
+        Cc14,
+        Rpn,
+        Nrpn,
+        Chord,
+        Transaction,
+        Overrun,
+        End,
+    };
+
     struct MidiMessage
     {
+        EventType type;
         double deltaTime;
         unsigned char *message;
         size_t messageLength;
+        uint32_t *ump;
+        size_t umpLength;
+        uint8_t channel;
+        uint16_t param;
+        uint16_t value;
+        uint32_t request;
+        SysexMatcher::Outcome::Type outcome;
+        unsigned long long overruns;
+        unsigned int poolSize;
+        // Only set while the input_dispatch probe is enabled
+        uint64_t queuedAt;
+    };
+
+    // A request made through NodeMidiOutput::Request, only touched on the JS thread
+    struct Transaction
+    {
+        Napi::Promise::Deferred deferred;
+        // Keeps the output alive while the matcher may still resend through it
+        Napi::ObjectReference output;
     };
 
     static void CallbackJs(Napi::Env env, Napi::Function callback, NodeMidiInput *context, MidiMessage *data);
     using TSFN_t = Napi::TypedThreadSafeFunction<NodeMidiInput, MidiMessage, CallbackJs>;
 
+    // Created when first needed, as opening an RtMidi client is expensive
+    // on some APIs. Port listing goes through PortEnumerator until then.
     std::unique_ptr<RtMidiIn> handle;
+    RtMidi::Api api = RtMidi::UNSPECIFIED;
+    bool destroyed = false;
+
+    // Applied to the handle when it is created
+    unsigned int bufferSize = 2048;
+    unsigned int bufferCount = 4;
+    bool ignoreSysex = true;
+    bool ignoreTiming = true;
+    bool ignoreSensing = true;
+    // Driver input pool and buffer, zero leaves the default
+    unsigned int inputPoolSize = 0;
+    unsigned int inputPoolBufferSize = 0;
+    // Largest pool to grow to after an overrun, zero to not grow
+    unsigned int inputPoolLimit = 0;
+
+    // Identifies this port in the flight recorder
+    uint16_t recorderPort;
+
+    PortStats stats;
 
     TSFN_t handleMessage;
     Napi::FunctionReference emitMessage;
     bool configured = false;
+    // Owned by the TSFN finalizer, set once closePortAndRemoveCallback has released the TSFN
+    bool *callbackReleased = nullptr;
+
+    // 0 when disabled, otherwise the protocol in the low nibble and the group above it
+    std::atomic<int> umpMode{0};
+
+    // Guards the processing stages, which run on both the RtMidi and timer threads
+    std::mutex pipelineMutex;
+    // Sum of the RtMidi delta times, used to time events emitted by the stages
+    double streamTime = 0;
+    double lastEmitTime = 0;
+
+    ParameterAssembler parameters;
+    std::vector<ParameterAssembler::Parameter> completedParameters;
+
+    SysexMatcher sysex;
+    std::vector<SysexMatcher::Outcome> sysexOutcomes;
+
+    ChordAssembler chords;
+    std::vector<ChordAssembler::Chord> completedChords;
+
+    ControllerThinner thinner;
+    std::vector<ControllerThinner::Message> thinnedMessages;
+
+    // Rules run on each short message ahead of the other stages. Only what
+    // they forward to target 0 carries on to the stages and JS.
+    TransformVm transform;
+    std::vector<TransformVm::Emitted> transformed;
+    // The outputs behind the other targets, referenced so they outlive the program
+    std::vector<NodeMidiOutput *> transformTargets;
+    std::vector<Napi::ObjectReference> transformOutputs;
 
+    // Sequencers arpeggiating the notes held on this port, they unfollow
+    // before they are destroyed
+    std::vector<NodeMidiSequencer *> followers;
+
+    CaptureWriter capture;
+    double captureStart = 0;
+
+    // Where every message received is published for subscribers, if anywhere
+    std::shared_ptr<MessageHub> hub;
+
+    // Feeds a capture through Callback in place of RtMidi
+    std::thread replayThread;
+    std::atomic<bool> replayStopping{false};
+    // Set while the replay thread is still delivering, it counts as an open port
+    std::atomic<bool> replaying{false};
+
+    uint32_t nextRequest = 0;
+    std::map<uint32_t, Transaction> transactions;
+
+    // Declared last, so its thread is stopped before the state it touches is destroyed
+    DeadlineTimer timer;
+
+    // Throws and returns false if the handle can't be created
+    bool ensureHandle(const Napi::Env &env);
     void setupCallback(const Napi::Env &env);
     void closePortAndRemoveCallback();
 
+    void replay(std::vector<CaptureEvent> events, bool realtime);
+    void stopReplay();
+
+    void process(const unsigned char *message, size_t length, double time);
+    void dispatch(MidiMessage *data, double time);
+    void emitMidi(const unsigned char *message, size_t length, double time);
+    void emitParameters();
+    void emitChords();
+    void emitThinned();
+    void emitOutcomes(double time);
+    void settleRequest(const Napi::Env &env, MidiMessage *data);
+    void rejectRequests(const Napi::Env &env);
+    DeadlineTimer::Clock::time_point expireStages(DeadlineTimer::Clock::time_point now);
+
+    static void freeMessage(MidiMessage *data);
+
 public:
     static std::unique_ptr<Napi::FunctionReference>
     Init(const Napi::Env &env, Napi::Object target);
@@ -36,18 +178,50 @@ public:
     ~NodeMidiInput();
 
     static void Callback(double deltaTime, std::vector<unsigned char> *message, void *userData);
+    static void Overrun(const RtMidiIn::InputOverrun &overrun, void *userData);
+
+    // Registers a sysex request, returning the promise it will settle. The
+    // caller sends the request once this returns.
+    Napi::Value beginRequest(const Napi::Env &env, SysexMatcher::Request request, Napi::Object output, uint32_t &id);
+    void failRequest(const Napi::Env &env, uint32_t id, const char *reason);
+
+    // Pass every incoming message to a sequencer as well, from the input thread
+    void follow(NodeMidiSequencer *sequencer);
+    void unfollow(NodeMidiSequencer *sequencer);
 
     Napi::Value GetPortCount(const Napi::CallbackInfo &info);
     Napi::Value GetPortName(const Napi::CallbackInfo &info);
 
     Napi::Value OpenPort(const Napi::CallbackInfo &info);
     Napi::Value OpenVirtualPort(const Napi::CallbackInfo &info);
+    Napi::Value SwitchPort(const Napi::CallbackInfo &info);
     Napi::Value ClosePort(const Napi::CallbackInfo &info);
     Napi::Value Destroy(const Napi::CallbackInfo &info);
     Napi::Value IsPortOpen(const Napi::CallbackInfo &info);
 
     Napi::Value IgnoreTypes(const Napi::CallbackInfo &info);
     Napi::Value SetBufferSize(const Napi::CallbackInfo &info);
+    Napi::Value SetInputPool(const Napi::CallbackInfo &info);
+    Napi::Value SetInputAutoGrow(const Napi::CallbackInfo &info);
+
+    Napi::Value EnableUmp(const Napi::CallbackInfo &info);
+    Napi::Value DisableUmp(const Napi::CallbackInfo &info);
+
+    Napi::Value AssembleParameters(const Napi::CallbackInfo &info);
+    Napi::Value AssembleChords(const Napi::CallbackInfo &info);
+    Napi::Value ThinControllers(const Napi::CallbackInfo &info);
+
+    Napi::Value SetTransform(const Napi::CallbackInfo &info);
+    Napi::Value ClearTransform(const Napi::CallbackInfo &info);
+
+    Napi::Value Publish(const Napi::CallbackInfo &info);
+    Napi::Value Unpublish(const Napi::CallbackInfo &info);
+
+    Napi::Value StartCapture(const Napi::CallbackInfo &info);
+    Napi::Value StopCapture(const Napi::CallbackInfo &info);
+    Napi::Value Replay(const Napi::CallbackInfo &info);
+
+    Napi::Value GetStats(const Napi::CallbackInfo &info);
 };
 
 #endif // NODE_MIDI_INPUT_H
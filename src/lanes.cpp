@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include "lanes.h"
+
+void OutputLanes::configure(bool enable, double bytesPerSecond, size_t size)
+{
+    enabled = enable;
+    rate = bytesPerSecond;
+    // Room for at least one data byte besides the F0 or F7
+    chunkSize = std::max<size_t>(size, 2);
+}
+
+bool OutputLanes::route(const unsigned char *message, size_t length)
+{
+    if (!enabled || length == 0 || message[0] >= 0xF8)
+    {
+        return false;
+    }
+
+    if (message[0] == 0xF0)
+    {
+        bulk.emplace_back(message, message + length);
+    }
+    else if (offset > 0 || !voice.empty())
+    {
+        voice.emplace_back(message, message + length);
+    }
+    else
+    {
+        return false;
+    }
+
+    pendingBytes += length;
+    return true;
+}
+
+void OutputLanes::takeVoice(std::vector<Chunk> &out)
+{
+    while (!voice.empty())
+    {
+        out.emplace_back();
+        out.back().bytes = voice.front();
+        out.back().finished = std::move(voice.front());
+        pendingBytes -= out.back().bytes.size();
+        voice.pop_front();
+    }
+}
+
+OutputLanes::Clock::time_point OutputLanes::take(Clock::time_point now, bool segments, std::vector<Chunk> &out)
+{
+    if (offset == 0)
+    {
+        takeVoice(out);
+    }
+
+    if (bulk.empty())
+    {
+        return Clock::time_point::max();
+    }
+    // Once turned off, whatever is left goes out as fast as it is taken
+    if (enabled && due > now)
+    {
+        return due;
+    }
+
+    std::vector<unsigned char> &front = bulk.front();
+    size_t length = segments ? std::min(chunkSize, front.size() - offset) : front.size() - offset;
+
+    out.emplace_back();
+    Chunk &chunk = out.back();
+    chunk.bytes.assign(front.begin() + offset, front.begin() + offset + length);
+    chunk.segment = offset > 0 || length < front.size();
+    offset += length;
+    pendingBytes -= length;
+
+    if (offset == front.size())
+    {
+        chunk.finished = std::move(front);
+        bulk.pop_front();
+        offset = 0;
+
+        // Whatever waited for the end of the sysex goes before the next one
+        takeVoice(out);
+    }
+
+    // Paced from when the chunk went out, so a late wakeup never causes a burst
+    due = now;
+    if (rate > 0)
+    {
+        due += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(length / rate));
+    }
+
+    return bulk.empty() ? Clock::time_point::max() : due;
+}
+
+size_t OutputLanes::clear(std::vector<unsigned char> &ending)
+{
+    if (offset > 0)
+    {
+        ending.push_back(0xF7);
+    }
+
+    size_t dropped = voice.size() + bulk.size();
+    voice.clear();
+    bulk.clear();
+    offset = 0;
+    pendingBytes = 0;
+    return dropped;
+}
@@ -0,0 +1,69 @@
+#ifndef NODE_MIDI_LANES_H
+#define NODE_MIDI_LANES_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Separates what an output sends into lanes, so a long sysex dump never
+// holds up clock. System real time messages always go straight out. Other
+// messages go out next, ahead of any sysex still waiting. Sysex is queued
+// in a bulk lane and let out no faster than the wire can carry it.
+//
+// Where the backend can send sysex in segments, each chunk of the bulk
+// lane is a segment, and real time messages land between them. MIDI only
+// allows real time messages inside a sysex, so other messages sent while
+// one is part way out wait for its end in a lane of their own. Otherwise a
+// chunk is a whole message, and nothing ever waits but sysex.
+class OutputLanes
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chunk
+    {
+        std::vector<unsigned char> bytes;
+        // Part of a sysex, rather than a whole message
+        bool segment = false;
+        // The message this chunk finishes, if it finishes one
+        std::vector<unsigned char> finished;
+    };
+
+    // A rate of zero lets chunks out as fast as the timer runs. Anything
+    // queued is kept.
+    void configure(bool enable, double bytesPerSecond, size_t chunkSize);
+    bool isEnabled() const { return enabled; }
+
+    // Returns true when the message was queued, or false when it is to be
+    // sent straight away
+    bool route(const unsigned char *message, size_t length);
+
+    // Appends the chunks due by now, and returns when it next needs to run
+    Clock::time_point take(Clock::time_point now, bool segments, std::vector<Chunk> &out);
+
+    // Bytes waiting in either lane
+    size_t pending() const { return pendingBytes; }
+
+    // Discards everything queued, returning the number of messages dropped.
+    // A sysex which was part way out is ended, so the receiver isn't left
+    // in the middle of it.
+    size_t clear(std::vector<unsigned char> &ending);
+
+private:
+    bool enabled = false;
+    double rate = 3125;
+    size_t chunkSize = 32;
+
+    std::deque<std::vector<unsigned char>> voice;
+    std::deque<std::vector<unsigned char>> bulk;
+    // Bytes of the front sysex already sent
+    size_t offset = 0;
+    size_t pendingBytes = 0;
+    Clock::time_point due;
+
+    void takeVoice(std::vector<Chunk> &out);
+};
+
+#endif // NODE_MIDI_LANES_H
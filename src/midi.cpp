@@ -1,18 +1,174 @@
 #include <napi.h>
 
+#include "RtMidi.h"
+
 #include "input.h"
+#include "midi.h"
 #include "output.h"
+#include "ports.h"
+#include "recorder.h"
+#include "sequencer.h"
+#include "splitter.h"
+#include "stats.h"
+#include "subscriber.h"
+
+static Napi::Value SetLoopbackLatency(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be a number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    RtMidiLoopback::setLatency(info[0].ToNumber().DoubleValue() / 1000);
 
-struct MidiInstanceData
+    return env.Null();
+}
+
+static Napi::Value SetBusName(const Napi::CallbackInfo &info)
 {
-    std::unique_ptr<Napi::FunctionReference> output;
-    std::unique_ptr<Napi::FunctionReference> input;
-};
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "First argument must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+#if defined(__RTMIDI_SHM__)
+    RtMidiShm::setBusName(info[0].ToString().Utf8Value());
+#else
+    Napi::Error::New(env, "Shared memory buses are not supported on this platform").ThrowAsJavaScriptException();
+#endif
+
+    return env.Null();
+}
+
+#if !defined(__RTMIDI_RTP__)
+static Napi::Value RtpUnsupported(const Napi::Env &env)
+{
+    Napi::Error::New(env, "RTP-MIDI is not supported on this platform").ThrowAsJavaScriptException();
+    return env.Null();
+}
+#endif
+
+static Napi::Value SetRtpPort(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be a number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // The data port is the one after it, so that has to fit too
+    double port = info[0].ToNumber().DoubleValue();
+    if (!(port >= 1 && port <= 65534) || port != static_cast<unsigned short>(port))
+    {
+        Napi::RangeError::New(env, "Port must be between 1 and 65534").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+#if defined(__RTMIDI_RTP__)
+    RtMidiRtp::setLocalPort(static_cast<unsigned short>(port));
+    return env.Null();
+#else
+    return RtpUnsupported(env);
+#endif
+}
+
+static Napi::Value AddRtpPeer(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() < 3 || !info[0].IsString() || !info[1].IsString() || !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected a name, a host and a port").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double port = info[2].ToNumber().DoubleValue();
+    if (!(port >= 1 && port <= 65534) || port != static_cast<unsigned short>(port))
+    {
+        Napi::RangeError::New(env, "Port must be between 1 and 65534").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+#if defined(__RTMIDI_RTP__)
+    RtMidiRtp::addPeer(info[0].ToString().Utf8Value(), info[1].ToString().Utf8Value(), static_cast<unsigned short>(port));
+    return env.Null();
+#else
+    return RtpUnsupported(env);
+#endif
+}
+
+static Napi::Value RemoveRtpPeer(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "First argument must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+#if defined(__RTMIDI_RTP__)
+    return Napi::Boolean::New(env, RtMidiRtp::removePeer(info[0].ToString().Utf8Value()));
+#else
+    return RtpUnsupported(env);
+#endif
+}
+
+static Napi::Value SetRtpPacketLoss(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be a number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double fraction = info[0].ToNumber().DoubleValue();
+    if (!(fraction >= 0 && fraction <= 1))
+    {
+        Napi::RangeError::New(env, "Packet loss must be between 0 and 1").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+#if defined(__RTMIDI_RTP__)
+    RtMidiRtp::setPacketLoss(fraction);
+    return env.Null();
+#else
+    return RtpUnsupported(env);
+#endif
+}
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports)
 {
     auto outputRef = NodeMidiOutput::Init(env, exports);
     auto inputRef = NodeMidiInput::Init(env, exports);
+    FlightRecorder::Init(env, exports);
+    PortStats::Init(env, exports);
+    PortEnumerator::Init(env, exports);
+    MidiSplitter::Init(env, exports);
+    NodeMidiSequencer::Init(env, exports);
+    NodeMidiSubscriber::Init(env, exports);
+    exports.Set("setLoopbackLatency", Napi::Function::New(env, SetLoopbackLatency, "setLoopbackLatency"));
+    exports.Set("setBusName", Napi::Function::New(env, SetBusName, "setBusName"));
+    exports.Set("setRtpPort", Napi::Function::New(env, SetRtpPort, "setRtpPort"));
+    exports.Set("addRtpPeer", Napi::Function::New(env, AddRtpPeer, "addRtpPeer"));
+    exports.Set("removeRtpPeer", Napi::Function::New(env, RemoveRtpPeer, "removeRtpPeer"));
+    exports.Set("setRtpPacketLoss", Napi::Function::New(env, SetRtpPacketLoss, "setRtpPacketLoss"));
 
     // Store the constructor as the add-on instance data. This will allow this
     // add-on to support multiple instances of itself running on multiple worker
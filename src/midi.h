@@ -0,0 +1,12 @@
+#ifndef NODE_MIDI_MIDI_H
+#define NODE_MIDI_MIDI_H
+
+#include <napi.h>
+
+struct MidiInstanceData
+{
+    std::unique_ptr<Napi::FunctionReference> output;
+    std::unique_ptr<Napi::FunctionReference> input;
+};
+
+#endif // NODE_MIDI_MIDI_H
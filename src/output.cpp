@@ -1,8 +1,23 @@
 #include <napi.h>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
 
 #include "RtMidi.h"
 
+#include "input.h"
+#include "midi.h"
 #include "output.h"
+#include "ports.h"
+#include "probes.h"
+#include "recorder.h"
+
+// Sends on an output which was never opened are dropped with a warning, as
+// RtMidi does for one which has been closed
+static void warnNotOpen()
+{
+    std::cerr << "\nNodeMidiOutput: no open port!\n\n";
+}
 
 std::unique_ptr<Napi::FunctionReference> NodeMidiOutput::Init(const Napi::Env &env, Napi::Object exports)
 {
@@ -20,6 +35,21 @@ std::unique_ptr<Napi::FunctionReference> NodeMidiOutput::Init(const Napi::Env &e
 
                                                                  InstanceMethod<&NodeMidiOutput::Send>("sendMessage", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                                  InstanceMethod<&NodeMidiOutput::Send>("send", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::SendUmp>("sendUmp", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::SendMessages>("sendMessages", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::Request>("request", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                 InstanceMethod<&NodeMidiOutput::Cc14>("cc14", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::Rpn>("rpn", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::Nrpn>("nrpn", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                 InstanceMethod<&NodeMidiOutput::SetOutputPool>("setOutputPool", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                 InstanceMethod<&NodeMidiOutput::CoalesceControllers>("coalesceControllers", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::Flush>("flush", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 InstanceMethod<&NodeMidiOutput::SetPriorityLanes>("setPriorityLanes", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                 InstanceMethod<&NodeMidiOutput::GetStats>("getStats", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                                              });
 
     // Create a persistent reference to the class constructor
@@ -30,42 +60,67 @@ std::unique_ptr<Napi::FunctionReference> NodeMidiOutput::Init(const Napi::Env &e
     return constructor;
 }
 
-static RtMidi::Api parseApi(const std::string &name)
+NodeMidiOutput::NodeMidiOutput(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeMidiOutput>(info),
+      recorderPort(FlightRecorder::nextPort()),
+      timer([this](DeadlineTimer::Clock::time_point now) { return tick(now); })
 {
-    if (name == "winmm") return RtMidi::WINDOWS_MM;
-    if (name == "uwp") return RtMidi::WINDOWS_UWP;
-    if (name == "core") return RtMidi::MACOSX_CORE;
-    if (name == "alsa") return RtMidi::LINUX_ALSA;
-    if (name == "jack") return RtMidi::UNIX_JACK;
-    return RtMidi::UNSPECIFIED;
-}
-
-NodeMidiOutput::NodeMidiOutput(const Napi::CallbackInfo &info) : Napi::ObjectWrap<NodeMidiOutput>(info)
-{
-    RtMidi::Api api = RtMidi::UNSPECIFIED;
     if (info.Length() >= 1 && info[0].IsString())
     {
         api = parseApi(info[0].ToString().Utf8Value());
     }
+}
 
-    try
-    {
-        handle.reset(new RtMidiOut(api));
-    }
-    catch (RtMidiError &e)
+NodeMidiOutput::~NodeMidiOutput()
+{
+    timer.shutdown();
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    if (handle)
     {
+        dropLanes();
+        flushHeld();
+        handle->closePort();
         handle.reset();
-        Napi::Error::New(info.Env(), "Failed to initialise RtMidi").ThrowAsJavaScriptException();
     }
 }
 
-NodeMidiOutput::~NodeMidiOutput()
+bool NodeMidiOutput::ensureHandle(const Napi::Env &env)
 {
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return false;
+    }
+
     if (handle)
     {
-        handle->closePort();
-        handle.reset();
+        return true;
     }
+
+    try
+    {
+        std::unique_ptr<RtMidiOut> created(new RtMidiOut(api));
+        if (poolSize > 0 || poolBufferSize > 0)
+        {
+            created->setOutputPool(poolSize, poolBufferSize);
+        }
+        if (drainTimeout >= 0)
+        {
+            created->setDrainTimeout(static_cast<unsigned int>(drainTimeout));
+        }
+
+        std::lock_guard<std::mutex> lock(sendMutex);
+        handle = std::move(created);
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Failed to initialise RtMidi").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
 }
 
 Napi::Value NodeMidiOutput::GetPortCount(const Napi::CallbackInfo &info)
@@ -73,13 +128,21 @@ Napi::Value NodeMidiOutput::GetPortCount(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    return Napi::Number::New(env, handle->getPortCount());
+    try
+    {
+        return Napi::Number::New(env, handle ? handle->getPortCount() : PortEnumerator::outputCount(api));
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Failed to initialise RtMidi").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 }
 
 Napi::Value NodeMidiOutput::GetPortName(const Napi::CallbackInfo &info)
@@ -87,7 +150,7 @@ Napi::Value NodeMidiOutput::GetPortName(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
@@ -102,7 +165,7 @@ Napi::Value NodeMidiOutput::GetPortName(const Napi::CallbackInfo &info)
     unsigned int portNumber = info[0].ToNumber();
     try
     {
-        return Napi::String::New(env, handle->getPortName(portNumber));
+        return Napi::String::New(env, handle ? handle->getPortName(portNumber) : PortEnumerator::outputName(api, portNumber));
     }
     catch (RtMidiError &e)
     {
@@ -116,9 +179,8 @@ Napi::Value NodeMidiOutput::OpenPort(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (!ensureHandle(env))
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
@@ -135,9 +197,18 @@ Napi::Value NodeMidiOutput::OpenPort(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
+    std::lock_guard<std::mutex> lock(sendMutex);
+
     try
     {
+        parameterEncoder.reset();
         handle->openPort(portNumber);
+
+        FlightRecorder &recorder = FlightRecorder::instance();
+        if (recorder.isOpen())
+        {
+            recorder.record(recorderPort, FlightRecorder::OpenOut, handle->getPortName(portNumber));
+        }
     }
     catch (RtMidiError &e)
     {
@@ -152,9 +223,8 @@ Napi::Value NodeMidiOutput::OpenVirtualPort(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (!ensureHandle(env))
     {
-        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
@@ -166,9 +236,13 @@ Napi::Value NodeMidiOutput::OpenVirtualPort(const Napi::CallbackInfo &info)
 
     std::string name = info[0].ToString();
 
+    std::lock_guard<std::mutex> lock(sendMutex);
+
     try
     {
+        parameterEncoder.reset();
         handle->openVirtualPort(name);
+        FlightRecorder::instance().record(recorderPort, FlightRecorder::OpenOut, name);
     }
     catch (RtMidiError &e)
     {
@@ -183,13 +257,19 @@ Napi::Value NodeMidiOutput::ClosePort(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    handle->closePort();
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (handle)
+    {
+        dropLanes();
+        flushHeld();
+        handle->closePort();
+    }
     return env.Null();
 }
 
@@ -198,13 +278,22 @@ Napi::Value NodeMidiOutput::Destroy(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         return env.Null();
     }
 
-    handle->closePort();
-    handle.reset();
+    timer.stop();
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (handle)
+    {
+        dropLanes();
+        flushHeld();
+        handle->closePort();
+        handle.reset();
+    }
+    destroyed = true;
 
     return env.Null();
 }
@@ -214,13 +303,13 @@ Napi::Value NodeMidiOutput::IsPortOpen(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    return Napi::Boolean::New(env, handle->isPortOpen());
+    return Napi::Boolean::New(env, handle && handle->isPortOpen());
 }
 
 Napi::Value NodeMidiOutput::Send(const Napi::CallbackInfo &info)
@@ -228,7 +317,7 @@ Napi::Value NodeMidiOutput::Send(const Napi::CallbackInfo &info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    if (!handle)
+    if (destroyed)
     {
         Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
         return env.Null();
@@ -242,14 +331,838 @@ Napi::Value NodeMidiOutput::Send(const Napi::CallbackInfo &info)
 
     Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
 
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // Never opened, so there is nowhere to send to
+    if (!handle)
+    {
+        warnNotOpen();
+        stats.add(PortStats::DroppedSend);
+        return env.Null();
+    }
+
+    NODE_MIDI_PROBE(output_send_entry, recorderPort, buffer.Length(), nodeMidiProbeTime());
+    bool sent = true;
+
+    size_t length = buffer.Length();
+    const unsigned char *bytes = buffer.Data();
+    const size_t *sizes = &length;
+    size_t count = 1;
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+
+    try
+    {
+        parameterEncoder.observe(buffer.Data(), buffer.Length());
+        prepare(bytes, sizes, count, preparedBytes, preparedSizes);
+
+        if (count == 1)
+        {
+            handle->sendMessage(bytes, sizes[0]);
+            stats.sent(bytes, sizes, 1);
+            FlightRecorder::instance().record(recorderPort, FlightRecorder::Out, bytes, sizes[0]);
+        }
+        else if (count > 1)
+        {
+            handle->sendMessages(bytes, sizes, count);
+            stats.sent(bytes, sizes, count);
+            recordSent(bytes, sizes, count);
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        sent = false;
+        stats.add(PortStats::DroppedSend, count);
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+    }
+
+    NODE_MIDI_PROBE(output_send_return, recorderPort, buffer.Length(), nodeMidiProbeTime(), sent);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::SendUmp(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array)
+    {
+        Napi::TypeError::New(env, "First argument must be a Uint32Array").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Uint32Array words = info[0].As<Napi::Uint32Array>();
+
+    // Reject a trailing partial packet before any sysex state is touched
+    if (Ump::wholePackets(words.Data(), words.ElementLength()) != words.ElementLength())
+    {
+        stats.add(PortStats::EncodeErrors);
+        Napi::RangeError::New(env, "Incomplete UMP packet").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // Never opened, so there is nowhere to send to
+    if (!handle)
+    {
+        warnNotOpen();
+        stats.add(PortStats::DroppedSend);
+        return env.Null();
+    }
+
+    // The decoder keeps sysex state between calls, so only decode what is
+    // going to be sent, and only with the send lock held
+    std::vector<unsigned char> bytes;
+    std::vector<size_t> lengths;
+    umpDecoder.decode(words.Data(), words.ElementLength(), bytes, lengths);
+
+    if (lengths.empty())
+    {
+        return env.Null();
+    }
+
+    NODE_MIDI_PROBE(output_send_entry, recorderPort, bytes.size(), nodeMidiProbeTime());
+    bool sent = true;
+
+    const unsigned char *data = bytes.data();
+    const size_t *sizes = lengths.data();
+    size_t count = lengths.size();
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+
+    try
+    {
+        parameterEncoder.observe(bytes.data(), bytes.size());
+        prepare(data, sizes, count, preparedBytes, preparedSizes);
+
+        if (count > 0)
+        {
+            handle->sendMessages(data, sizes, count);
+            stats.sent(data, sizes, count);
+            recordSent(data, sizes, count);
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        sent = false;
+        stats.add(PortStats::DroppedSend, count);
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+    }
+
+    NODE_MIDI_PROBE(output_send_return, recorderPort, bytes.size(), nodeMidiProbeTime(), sent);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::SendMessages(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 3 || !info[0].IsBuffer() || !info[1].IsTypedArray() || info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array || !info[2].IsTypedArray() || info[2].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array)
+    {
+        Napi::TypeError::New(env, "Expected a buffer and two Uint32Arrays").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
+    Napi::Uint32Array offsets = info[1].As<Napi::Uint32Array>();
+    Napi::Uint32Array lengths = info[2].As<Napi::Uint32Array>();
+
+    size_t count = offsets.ElementLength();
+    if (lengths.ElementLength() != count)
+    {
+        Napi::RangeError::New(env, "Offsets and lengths must be the same length").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Messages laid out back to back, as splitMessages() returns them, are
+    // sent straight from the buffer, anything else is gathered first
+    std::vector<size_t> sizes(count);
+    bool contiguous = true;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t offset = offsets.Data()[i];
+        sizes[i] = lengths.Data()[i];
+        if (sizes[i] == 0 || offset + sizes[i] > buffer.Length())
+        {
+            Napi::RangeError::New(env, "Invalid message offset or length").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        contiguous = contiguous && offset == offsets.Data()[0] + total;
+        total += sizes[i];
+    }
+
+    if (count == 0)
+    {
+        return env.Null();
+    }
+
+    std::vector<unsigned char> gathered;
+    const unsigned char *bytes = buffer.Data() + offsets.Data()[0];
+    if (!contiguous)
+    {
+        gathered.reserve(total);
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned char *message = buffer.Data() + offsets.Data()[i];
+            gathered.insert(gathered.end(), message, message + sizes[i]);
+        }
+        bytes = gathered.data();
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // Never opened, so there is nowhere to send to
+    if (!handle)
+    {
+        warnNotOpen();
+        stats.add(PortStats::DroppedSend, count);
+        return env.Null();
+    }
+
+    NODE_MIDI_PROBE(output_send_entry, recorderPort, total, nodeMidiProbeTime());
+    bool sent = true;
+
+    const size_t *messageSizes = sizes.data();
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+
     try
     {
-        handle->sendMessage(buffer.Data(), buffer.Length());
+        parameterEncoder.observe(bytes, total);
+        prepare(bytes, messageSizes, count, preparedBytes, preparedSizes);
+
+        if (count > 0)
+        {
+            handle->sendMessages(bytes, messageSizes, count);
+            stats.sent(bytes, messageSizes, count);
+            recordSent(bytes, messageSizes, count);
+        }
     }
     catch (RtMidiError &e)
     {
+        sent = false;
+        stats.add(PortStats::DroppedSend, count);
         Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
     }
 
+    NODE_MIDI_PROBE(output_send_return, recorderPort, total, nodeMidiProbeTime(), sent);
+
     return env.Null();
 }
+
+void NodeMidiOutput::recordSent(const unsigned char *bytes, const size_t *sizes, size_t count)
+{
+    FlightRecorder &recorder = FlightRecorder::instance();
+    if (!recorder.isOpen())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        recorder.record(recorderPort, FlightRecorder::Out, bytes, sizes[i]);
+        bytes += sizes[i];
+    }
+}
+
+void NodeMidiOutput::prepare(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                             std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes)
+{
+    std::vector<unsigned char> coalescedBytes;
+    std::vector<size_t> coalescedSizes;
+    if (coalescer.isEnabled())
+    {
+        bool staged = lanes.isEnabled();
+        coalesce(bytes, sizes, count, staged ? coalescedBytes : outBytes, staged ? coalescedSizes : outSizes);
+    }
+
+    if (lanes.isEnabled())
+    {
+        queueInLanes(bytes, sizes, count, outBytes, outSizes);
+    }
+}
+
+void NodeMidiOutput::coalesce(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                              std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes)
+{
+    DeadlineTimer::Clock::time_point now = DeadlineTimer::Clock::now();
+    DeadlineTimer::Clock::time_point deadline = DeadlineTimer::Clock::time_point::max();
+
+    const unsigned char *message = bytes;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (coalescer.process(message, sizes[i], now, outBytes, outSizes, deadline) == ControllerCoalescer::Superseded)
+        {
+            stats.add(PortStats::Coalesced);
+        }
+        message += sizes[i];
+    }
+
+    if (deadline != DeadlineTimer::Clock::time_point::max())
+    {
+        timer.schedule(deadline);
+    }
+
+    bytes = outBytes.data();
+    sizes = outSizes.data();
+    count = outSizes.size();
+}
+
+void NodeMidiOutput::queueInLanes(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                                  std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes)
+{
+    bool queued = false;
+    const unsigned char *message = bytes;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (lanes.route(message, sizes[i]))
+        {
+            queued = true;
+        }
+        else
+        {
+            outBytes.insert(outBytes.end(), message, message + sizes[i]);
+            outSizes.push_back(sizes[i]);
+        }
+        message += sizes[i];
+    }
+
+    if (queued)
+    {
+        timer.schedule(DeadlineTimer::Clock::now());
+    }
+
+    bytes = outBytes.data();
+    sizes = outSizes.data();
+    count = outSizes.size();
+}
+
+void NodeMidiOutput::flushHeld()
+{
+    std::vector<unsigned char> bytes;
+    std::vector<size_t> sizes;
+    coalescer.flush(bytes, sizes);
+    writeHeld(bytes, sizes);
+}
+
+void NodeMidiOutput::drainLanes()
+{
+    bool segments = handle && handle->supportsSysexSegments();
+    std::vector<OutputLanes::Chunk> chunks;
+    while (lanes.pending() > 0)
+    {
+        lanes.take(DeadlineTimer::Clock::now(), segments, chunks);
+    }
+    writeChunks(chunks);
+}
+
+void NodeMidiOutput::dropLanes()
+{
+    std::vector<unsigned char> ending;
+    size_t dropped = lanes.clear(ending);
+    stats.add(PortStats::DroppedSend, dropped);
+
+    if (!ending.empty() && handle)
+    {
+        try
+        {
+            handle->sendSysexSegment(ending.data(), ending.size());
+        }
+        catch (RtMidiError &e)
+        {
+        }
+    }
+}
+
+DeadlineTimer::Clock::time_point NodeMidiOutput::tick(DeadlineTimer::Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    std::vector<unsigned char> bytes;
+    std::vector<size_t> sizes;
+    DeadlineTimer::Clock::time_point held = coalescer.expire(now, bytes, sizes);
+    writeHeld(bytes, sizes);
+
+    DeadlineTimer::Clock::time_point queued = DeadlineTimer::Clock::time_point::max();
+    if (handle)
+    {
+        std::vector<OutputLanes::Chunk> chunks;
+        queued = lanes.take(now, handle->supportsSysexSegments(), chunks);
+        writeChunks(chunks);
+    }
+
+    return std::min(held, queued);
+}
+
+void NodeMidiOutput::writeHeld(const std::vector<unsigned char> &bytes, const std::vector<size_t> &sizes)
+{
+    const unsigned char *data = bytes.data();
+    const size_t *messageSizes = sizes.data();
+    size_t count = sizes.size();
+
+    // Held values can't go out in the middle of a sysex either
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+    if (lanes.isEnabled())
+    {
+        queueInLanes(data, messageSizes, count, preparedBytes, preparedSizes);
+    }
+
+    if (count == 0 || !handle)
+    {
+        return;
+    }
+
+    // Nobody to report an error to, so it is only counted
+    try
+    {
+        handle->sendMessages(data, messageSizes, count);
+        stats.sent(data, messageSizes, count);
+        recordSent(data, messageSizes, count);
+    }
+    catch (RtMidiError &e)
+    {
+        stats.add(PortStats::DroppedSend, count);
+    }
+}
+
+void NodeMidiOutput::writeChunks(const std::vector<OutputLanes::Chunk> &chunks)
+{
+    for (const OutputLanes::Chunk &chunk : chunks)
+    {
+        try
+        {
+            if (chunk.segment)
+            {
+                handle->sendSysexSegment(chunk.bytes.data(), chunk.bytes.size());
+            }
+            else
+            {
+                handle->sendMessage(chunk.bytes.data(), chunk.bytes.size());
+            }
+
+            // Counted and recorded whole, once the last of it is out
+            if (!chunk.finished.empty())
+            {
+                size_t length = chunk.finished.size();
+                stats.sent(chunk.finished.data(), &length, 1);
+                FlightRecorder::instance().record(recorderPort, FlightRecorder::Out, chunk.finished.data(), length);
+            }
+        }
+        catch (RtMidiError &e)
+        {
+            if (!chunk.finished.empty())
+            {
+                stats.add(PortStats::DroppedSend);
+            }
+        }
+    }
+}
+
+bool NodeMidiOutput::sendRaw(const unsigned char *message, size_t length)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    if (!handle)
+    {
+        return false;
+    }
+
+    const unsigned char *bytes = message;
+    const size_t *sizes = &length;
+    size_t count = 1;
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+
+    try
+    {
+        prepare(bytes, sizes, count, preparedBytes, preparedSizes);
+
+        if (count > 0)
+        {
+            handle->sendMessages(bytes, sizes, count);
+            stats.sent(bytes, sizes, count);
+            recordSent(bytes, sizes, count);
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        stats.add(PortStats::DroppedSend, count);
+        return false;
+    }
+
+    return true;
+}
+
+Napi::Value NodeMidiOutput::Request(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 7 || !info[0].IsBuffer() || !info[1].IsObject() || !info[2].IsArray() || !info[3].IsNumber() || !info[4].IsBoolean() || !info[5].IsNumber() || !info[6].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected a buffer, an input, a pattern, a timeout, a boolean, a retry count and a wait timeout").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
+    if (buffer.Length() < 2 || buffer.Data()[0] != 0xF0 || buffer.Data()[buffer.Length() - 1] != 0xF7)
+    {
+        Napi::RangeError::New(env, "Request must be a complete sysex message").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    MidiInstanceData *instanceData = env.GetInstanceData<MidiInstanceData>();
+    Napi::Object inputObject = info[1].As<Napi::Object>();
+    if (!inputObject.InstanceOf(instanceData->input->Value()))
+    {
+        Napi::TypeError::New(env, "Second argument must be an input").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double timeout = info[3].ToNumber();
+    int retries = info[5].ToNumber();
+    double waitTimeout = info[6].ToNumber();
+    if (!(timeout >= 0) || retries < 0 || !(waitTimeout >= 0))
+    {
+        Napi::RangeError::New(env, "Timeout and retries must not be negative").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    SysexMatcher::Request request;
+    request.message.assign(buffer.Data(), buffer.Data() + buffer.Length());
+    request.timeout = std::chrono::duration_cast<SysexMatcher::Clock::duration>(std::chrono::duration<double, std::milli>(timeout));
+    request.waitTimeout = std::chrono::duration_cast<SysexMatcher::Clock::duration>(std::chrono::duration<double, std::milli>(waitTimeout));
+    request.handshake = info[4].ToBoolean();
+    request.retries = retries;
+
+    Napi::Array pattern = info[2].As<Napi::Array>();
+    for (uint32_t i = 0; i < pattern.Length(); i++)
+    {
+        Napi::Value byte = pattern.Get(i);
+        int value = byte.IsNumber() ? byte.ToNumber().Int32Value() : 256;
+        if (value < -1 || value > 255)
+        {
+            Napi::RangeError::New(env, "Pattern must contain bytes or wildcards").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        request.pattern.push_back(value);
+    }
+
+    if (request.pattern.empty() && !request.handshake)
+    {
+        Napi::RangeError::New(env, "A request without a handshake needs a pattern").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    NodeMidiInput *input = NodeMidiInput::Unwrap(inputObject);
+
+    NodeMidiOutput *output = this;
+    request.resend = [output](const std::vector<unsigned char> &message) {
+        output->sendRaw(message.data(), message.size());
+    };
+
+    // Register before sending, so a fast reply can't overtake the request
+    uint32_t id;
+    Napi::Value promise = input->beginRequest(env, std::move(request), Value(), id);
+    if (env.IsExceptionPending())
+    {
+        return env.Null();
+    }
+
+    if (!sendRaw(buffer.Data(), buffer.Length()))
+    {
+        input->failRequest(env, id, "Internal RtMidi error");
+    }
+
+    return promise;
+}
+
+Napi::Value NodeMidiOutput::Cc14(const Napi::CallbackInfo &info)
+{
+    return sendParameter(info, ParameterAssembler::CC14);
+}
+
+Napi::Value NodeMidiOutput::Rpn(const Napi::CallbackInfo &info)
+{
+    return sendParameter(info, ParameterAssembler::RPN);
+}
+
+Napi::Value NodeMidiOutput::Nrpn(const Napi::CallbackInfo &info)
+{
+    return sendParameter(info, ParameterAssembler::NRPN);
+}
+
+Napi::Value NodeMidiOutput::sendParameter(const Napi::CallbackInfo &info, ParameterAssembler::Kind kind)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int channel = info[0].ToNumber();
+    int param = info[1].ToNumber();
+    int value = info[2].ToNumber();
+    int maxParam = kind == ParameterAssembler::CC14 ? 31 : 16383;
+    if (channel < 0 || channel > 15 || param < 0 || param > maxParam || value < 0 || value > 16383)
+    {
+        Napi::RangeError::New(env, "Invalid channel, parameter or value").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // Never opened, so there is nowhere to send to
+    if (!handle)
+    {
+        warnNotOpen();
+        stats.add(PortStats::DroppedSend);
+        return env.Null();
+    }
+
+    std::vector<unsigned char> bytes;
+    std::vector<size_t> sizes;
+    parameterEncoder.encode(kind, channel, param, value, bytes, sizes);
+
+    const unsigned char *data = bytes.data();
+    const size_t *messageSizes = sizes.data();
+    size_t count = sizes.size();
+    std::vector<unsigned char> preparedBytes;
+    std::vector<size_t> preparedSizes;
+
+    try
+    {
+        prepare(data, messageSizes, count, preparedBytes, preparedSizes);
+
+        if (count > 0)
+        {
+            handle->sendMessages(data, messageSizes, count);
+            stats.sent(data, messageSizes, count);
+            recordSent(data, messageSizes, count);
+        }
+    }
+    catch (RtMidiError &e)
+    {
+        stats.add(PortStats::DroppedSend, sizes.size());
+        // The device may not have seen the selection
+        parameterEncoder.reset();
+        Napi::Error::New(env, "Internal RtMidi error").ThrowAsJavaScriptException();
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::SetOutputPool(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() < 2 || info.Length() > 3 || !info[0].IsNumber() || !info[1].IsNumber() ||
+        (info.Length() == 3 && !info[2].IsUndefined() && !info[2].IsNumber()))
+    {
+        Napi::TypeError::New(env, "Arguments must be integers").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unsigned int pool = info[0].ToNumber();
+    unsigned int buffer = info[1].ToNumber();
+
+    // Closing waits for the queue while holding the send lock, so this
+    // bounds how long every other sender can be held up
+    bool hasTimeout = info.Length() == 3 && info[2].IsNumber();
+    if (hasTimeout)
+    {
+        double timeout = info[2].ToNumber();
+        if (!(timeout >= 0 && timeout <= UINT32_MAX))
+        {
+            Napi::RangeError::New(env, "Drain timeout is out of range").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        drainTimeout = timeout;
+    }
+
+    // Kept for a handle created later, where zero leaves a setting alone
+    if (pool > 0)
+    {
+        poolSize = pool;
+    }
+    if (buffer > 0)
+    {
+        poolBufferSize = buffer;
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (handle)
+    {
+        handle->setOutputPool(pool, buffer);
+        if (hasTimeout)
+        {
+            handle->setDrainTimeout(static_cast<unsigned int>(drainTimeout));
+        }
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::CoalesceControllers(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() == 0 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "First argument must be a number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Zero turns coalescing off, and Infinity holds values until flush()
+    double window = info[0].ToNumber().DoubleValue();
+    if (!(window >= 0))
+    {
+        Napi::RangeError::New(env, "Window must not be negative").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    ControllerCoalescer::Clock::duration duration = ControllerCoalescer::Clock::duration::zero();
+    if (window > 0 && !std::isinf(window))
+    {
+        duration = std::chrono::duration_cast<ControllerCoalescer::Clock::duration>(std::chrono::duration<double, std::milli>(window));
+        duration = std::max(duration, ControllerCoalescer::Clock::duration(1));
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // Anything held under the old settings goes out first
+    flushHeld();
+    coalescer.configure(window > 0, duration);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::Flush(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    flushHeld();
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::SetPriorityLanes(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (destroyed)
+    {
+        Napi::Error::New(env, "RtMidi not initialised").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 3 || !info[0].IsBoolean() || !info[1].IsNumber() || !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected a boolean, a rate and a chunk size").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double rate = info[1].ToNumber().DoubleValue();
+    double chunkSize = info[2].ToNumber().DoubleValue();
+    if (!(rate >= 0) || std::isinf(rate) || !(chunkSize >= 2 && chunkSize <= 65536))
+    {
+        Napi::RangeError::New(env, "Invalid rate or chunk size").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    bool enable = info[0].ToBoolean();
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    lanes.configure(enable, rate, static_cast<size_t>(chunkSize));
+
+    // Nothing new will be queued, so what is left goes out now
+    if (!enable)
+    {
+        drainLanes();
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiOutput::GetStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    Napi::Object result = stats.toObject(env);
+
+    // Output held back while the driver was full, kept by RtMidi
+    RtMidiOut::OutputQueueStats queue = {0, 0, 0};
+    if (handle)
+    {
+        queue = handle->getOutputQueueStats();
+    }
+    result.Set("stalls", Napi::Number::New(env, static_cast<double>(queue.stalls)));
+    result.Set("retries", Napi::Number::New(env, static_cast<double>(queue.retries)));
+    result.Set("pending", Napi::Number::New(env, static_cast<double>(queue.pending)));
+
+    // Bytes waiting in the priority lanes
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        result.Set("queuedBytes", Napi::Number::New(env, static_cast<double>(lanes.pending())));
+    }
+
+    return result;
+}
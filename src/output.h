@@ -2,13 +2,79 @@
 #define NODE_MIDI_OUTPUT_H
 
 #include <napi.h>
+#include <mutex>
 
 #include "RtMidi.h"
+#include "coalescer.h"
+#include "lanes.h"
+#include "params.h"
+#include "stats.h"
+#include "sysex.h"
+#include "timer.h"
+#include "ump.h"
 
 class NodeMidiOutput : public Napi::ObjectWrap<NodeMidiOutput>
 {
 private:
+    // Created when a port is first opened, as some APIs do a lot of work to
+    // set a client up
     std::unique_ptr<RtMidiOut> handle;
+    RtMidi::Api api = RtMidi::UNSPECIFIED;
+    bool destroyed = false;
+
+    // Applied to the handle when it is created, zero leaves the default
+    unsigned int poolSize = 0;
+    unsigned int poolBufferSize = 0;
+    // How long closing waits for queued output, or < 0 for the default
+    double drainTimeout = -1;
+
+    // Identifies this port in the flight recorder
+    uint16_t recorderPort;
+
+    PortStats stats;
+
+    // Sysex requests can be resent from the input thread, so sends and
+    // anything that tears down the handle take this lock
+    std::mutex sendMutex;
+
+    UmpDecoder umpDecoder;
+    ParameterEncoder parameterEncoder;
+
+    // Guarded by sendMutex, like everything else on the send path
+    ControllerCoalescer coalescer;
+    OutputLanes lanes;
+
+    // Sends held values once their window is up, and lets queued sysex
+    // out. Declared last, so its thread is stopped before the state it
+    // touches is destroyed.
+    DeadlineTimer timer;
+
+    // Create the handle if needed, takes sendMutex. Throws and returns false
+    // if it can't be created.
+    bool ensureHandle(const Napi::Env &env);
+
+    Napi::Value sendParameter(const Napi::CallbackInfo &info, ParameterAssembler::Kind kind);
+
+    void recordSent(const unsigned char *bytes, const size_t *sizes, size_t count);
+
+    // Runs messages through the coalescer and the lanes, when they are on,
+    // leaving bytes, sizes and count describing what is to be sent now,
+    // which may be nothing. Takes sendMutex held.
+    void prepare(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                 std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes);
+    void coalesce(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                  std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes);
+    void queueInLanes(const unsigned char *&bytes, const size_t *&sizes, size_t &count,
+                      std::vector<unsigned char> &outBytes, std::vector<size_t> &outSizes);
+    // Sends every held value, takes sendMutex held
+    void flushHeld();
+    // Sends everything in the lanes now, or drops it, takes sendMutex held
+    void drainLanes();
+    void dropLanes();
+    // Run on the timer thread, sends the held values and chunks which are due
+    DeadlineTimer::Clock::time_point tick(DeadlineTimer::Clock::time_point now);
+    void writeHeld(const std::vector<unsigned char> &bytes, const std::vector<size_t> &sizes);
+    void writeChunks(const std::vector<OutputLanes::Chunk> &chunks);
 
 public:
     static std::unique_ptr<Napi::FunctionReference> Init(const Napi::Env &env, Napi::Object target);
@@ -16,6 +82,9 @@ public:
     NodeMidiOutput(const Napi::CallbackInfo &info);
     ~NodeMidiOutput();
 
+    // Safe to call from any thread, returns false if the message was not sent
+    bool sendRaw(const unsigned char *message, size_t length);
+
     Napi::Value GetPortCount(const Napi::CallbackInfo &info);
     Napi::Value GetPortName(const Napi::CallbackInfo &info);
 
@@ -26,6 +95,22 @@ public:
     Napi::Value IsPortOpen(const Napi::CallbackInfo &info);
 
     Napi::Value Send(const Napi::CallbackInfo &info);
+    Napi::Value SendUmp(const Napi::CallbackInfo &info);
+    Napi::Value SendMessages(const Napi::CallbackInfo &info);
+
+    Napi::Value Request(const Napi::CallbackInfo &info);
+
+    Napi::Value Cc14(const Napi::CallbackInfo &info);
+    Napi::Value Rpn(const Napi::CallbackInfo &info);
+    Napi::Value Nrpn(const Napi::CallbackInfo &info);
+
+    Napi::Value SetOutputPool(const Napi::CallbackInfo &info);
+
+    Napi::Value CoalesceControllers(const Napi::CallbackInfo &info);
+    Napi::Value Flush(const Napi::CallbackInfo &info);
+    Napi::Value SetPriorityLanes(const Napi::CallbackInfo &info);
+
+    Napi::Value GetStats(const Napi::CallbackInfo &info);
 };
 
 #endif // NODE_MIDI_OUTPUT_H
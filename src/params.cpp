@@ -0,0 +1,264 @@
+#include "params.h"
+
+ParameterAssembler::ParameterAssembler()
+{
+    reset();
+}
+
+void ParameterAssembler::configure(const Options &newOptions)
+{
+    options = newOptions;
+    reset();
+}
+
+bool ParameterAssembler::isEnabled() const
+{
+    return options.cc14 || options.rpn || options.nrpn;
+}
+
+void ParameterAssembler::reset()
+{
+    for (ChannelState &state : channels)
+    {
+        state.selected = -1;
+        state.selectMsb = 0;
+        state.selectLsb = 0;
+        state.paired = 0;
+
+        for (int i = 0; i < 32; i++)
+        {
+            state.pending[i].msb = -1;
+            state.lastMsb[i] = -1;
+        }
+    }
+
+    pendingCount = 0;
+}
+
+bool ParameterAssembler::process(const unsigned char *message, size_t length, double time, Clock::time_point now, std::vector<Parameter> &out)
+{
+    if (length != 3 || (message[0] & 0xF0) != 0xB0)
+    {
+        return false;
+    }
+
+    uint8_t channel = message[0] & 0x0F;
+    uint8_t controller = message[1];
+    uint8_t value = message[2];
+    ChannelState &state = channels[channel];
+
+    if (controller >= 98 && controller <= 101)
+    {
+        Kind kind = controller >= 100 ? RPN : NRPN;
+        if (!(kind == RPN ? options.rpn : options.nrpn))
+        {
+            return false;
+        }
+
+        // Selecting a parameter ends data entry for the previous one
+        flush(state, 6, channel, out);
+        state.lastMsb[6] = -1;
+
+        if (state.selected != kind)
+        {
+            state.selected = kind;
+            state.selectMsb = 0;
+            state.selectLsb = 0;
+        }
+
+        // 99 and 101 carry the parameter MSB, 98 and 100 the LSB
+        if (controller & 1)
+        {
+            state.selectMsb = value;
+        }
+        else
+        {
+            state.selectLsb = value;
+        }
+
+        if (kind == RPN && state.selectMsb == 0x7F && state.selectLsb == 0x7F)
+        {
+            // RPN null deselects the parameter
+            state.selected = -1;
+        }
+
+        return true;
+    }
+
+    if ((controller == 6 || controller == 38) && state.selected >= 0)
+    {
+        if (controller == 6)
+        {
+            hold(state, 6, value, static_cast<Kind>(state.selected), (state.selectMsb << 7) | state.selectLsb, time, now, channel, out);
+            return true;
+        }
+
+        return complete(state, 6, value, time, channel, out);
+    }
+
+    if (!options.cc14 || controller >= 64)
+    {
+        return false;
+    }
+
+    if (controller < 32)
+    {
+        if (!(state.paired & (1u << controller)))
+        {
+            // Not known to send an LSB, so pass it on but remember it in case one follows
+            state.lastMsb[controller] = value;
+            return false;
+        }
+
+        hold(state, controller, value, CC14, controller, time, now, channel, out);
+        return true;
+    }
+
+    state.paired |= 1u << (controller - 32);
+    return complete(state, controller - 32, value, time, channel, out);
+}
+
+ParameterAssembler::Clock::time_point ParameterAssembler::expire(Clock::time_point now, std::vector<Parameter> &out)
+{
+    Clock::time_point next = Clock::time_point::max();
+    if (pendingCount == 0)
+    {
+        return next;
+    }
+
+    for (uint8_t channel = 0; channel < 16; channel++)
+    {
+        ChannelState &state = channels[channel];
+        for (uint8_t controller = 0; controller < 32; controller++)
+        {
+            Pending &pending = state.pending[controller];
+            if (pending.msb < 0)
+            {
+                continue;
+            }
+
+            if (pending.deadline <= now)
+            {
+                flush(state, controller, channel, out);
+            }
+            else if (pending.deadline < next)
+            {
+                next = pending.deadline;
+            }
+        }
+    }
+
+    return next;
+}
+
+void ParameterAssembler::hold(ChannelState &state, uint8_t controller, uint8_t msb, Kind kind, uint16_t param, double time, Clock::time_point now, uint8_t channel, std::vector<Parameter> &out)
+{
+    // Receiving a new MSB resets the LSB, so an unpaired MSB is complete as it is
+    flush(state, controller, channel, out);
+
+    Pending &pending = state.pending[controller];
+    pending.msb = msb;
+    pending.kind = kind;
+    pending.param = param;
+    pending.time = time;
+    pending.deadline = now + options.timeout;
+    pendingCount++;
+
+    state.lastMsb[controller] = msb;
+}
+
+bool ParameterAssembler::complete(ChannelState &state, uint8_t controller, uint8_t lsb, double time, uint8_t channel, std::vector<Parameter> &out)
+{
+    Pending &pending = state.pending[controller];
+    if (pending.msb >= 0)
+    {
+        out.push_back({pending.kind, channel, pending.param, static_cast<uint16_t>((pending.msb << 7) | lsb), pending.time});
+        pending.msb = -1;
+        pendingCount--;
+        return true;
+    }
+
+    if (state.lastMsb[controller] >= 0)
+    {
+        // An LSB on its own fine-tunes the previous value
+        Kind kind = CC14;
+        uint16_t param = controller;
+        if (controller == 6 && state.selected >= 0)
+        {
+            kind = static_cast<Kind>(state.selected);
+            param = (state.selectMsb << 7) | state.selectLsb;
+        }
+
+        out.push_back({kind, channel, param, static_cast<uint16_t>((state.lastMsb[controller] << 7) | lsb), time});
+        return true;
+    }
+
+    return false;
+}
+
+void ParameterAssembler::flush(ChannelState &state, uint8_t controller, uint8_t channel, std::vector<Parameter> &out)
+{
+    Pending &pending = state.pending[controller];
+    if (pending.msb < 0)
+    {
+        return;
+    }
+
+    out.push_back({pending.kind, channel, pending.param, static_cast<uint16_t>(pending.msb << 7), pending.time});
+    pending.msb = -1;
+    pendingCount--;
+}
+
+ParameterEncoder::ParameterEncoder()
+{
+    reset();
+}
+
+void ParameterEncoder::encode(ParameterAssembler::Kind kind, uint8_t channel, uint16_t param, uint16_t value, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes)
+{
+    unsigned char status = 0xB0 | (channel & 0x0F);
+    auto append = [&](uint8_t controller, uint8_t data) {
+        bytes.push_back(status);
+        bytes.push_back(controller);
+        bytes.push_back(data & 0x7F);
+        sizes.push_back(3);
+    };
+
+    if (kind == ParameterAssembler::CC14)
+    {
+        append(param, value >> 7);
+        append(param + 32, value);
+        return;
+    }
+
+    int32_t selection = (kind << 14) | param;
+    if (selected[channel & 0x0F] != selection)
+    {
+        bool registered = kind == ParameterAssembler::RPN;
+        append(registered ? 101 : 99, param >> 7);
+        append(registered ? 100 : 98, param);
+        selected[channel & 0x0F] = selection;
+    }
+
+    append(6, value >> 7);
+    append(38, value);
+}
+
+void ParameterEncoder::observe(const unsigned char *message, size_t length)
+{
+    for (size_t i = 0; i + 1 < length; i++)
+    {
+        if ((message[i] & 0xF0) == 0xB0 && message[i + 1] >= 98 && message[i + 1] <= 101)
+        {
+            selected[message[i] & 0x0F] = -1;
+        }
+    }
+}
+
+void ParameterEncoder::reset()
+{
+    for (int32_t &selection : selected)
+    {
+        selection = -1;
+    }
+}
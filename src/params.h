@@ -0,0 +1,111 @@
+#ifndef NODE_MIDI_PARAMS_H
+#define NODE_MIDI_PARAMS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Assembles high resolution controller traffic into single parameter
+// changes: 14-bit CC MSB/LSB pairs, and RPN/NRPN selection followed by data
+// entry. A lone MSB is reported once its LSB fails to arrive in time.
+// A 14-bit CC is only held back once its controller has been seen with an
+// LSB, so MSB-only controllers such as bank select pass through untouched.
+class ParameterAssembler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Kind
+    {
+        CC14,
+        RPN,
+        NRPN,
+    };
+
+    struct Parameter
+    {
+        Kind kind;
+        uint8_t channel;
+        uint16_t param;
+        uint16_t value;
+        // Stream time of the message which started the parameter
+        double time;
+    };
+
+    struct Options
+    {
+        bool cc14 = false;
+        bool rpn = false;
+        bool nrpn = false;
+        Clock::duration timeout = std::chrono::milliseconds(10);
+    };
+
+    ParameterAssembler();
+
+    // Replaces the options and discards any partial state
+    void configure(const Options &options);
+    const Options &getOptions() const { return options; }
+    bool isEnabled() const;
+
+    // Returns true when the message was consumed, appending any parameters it completed
+    bool process(const unsigned char *message, size_t length, double time, Clock::time_point now, std::vector<Parameter> &out);
+
+    // Completes parameters whose LSB is overdue, and returns the next deadline
+    Clock::time_point expire(Clock::time_point now, std::vector<Parameter> &out);
+
+    void reset();
+
+private:
+    struct Pending
+    {
+        int16_t msb;
+        Kind kind;
+        uint16_t param;
+        double time;
+        Clock::time_point deadline;
+    };
+
+    struct ChannelState
+    {
+        int selected; // Kind of the selected RPN/NRPN, or -1
+        uint8_t selectMsb;
+        uint8_t selectLsb;
+        // Indexed by the MSB controller number, slot 6 doubles as data entry
+        Pending pending[32];
+        int16_t lastMsb[32];
+        // Bit per MSB controller that has been followed by an LSB
+        uint32_t paired;
+    };
+
+    Options options;
+    ChannelState channels[16];
+    size_t pendingCount = 0;
+
+    void hold(ChannelState &state, uint8_t controller, uint8_t msb, Kind kind, uint16_t param, double time, Clock::time_point now, uint8_t channel, std::vector<Parameter> &out);
+    bool complete(ChannelState &state, uint8_t controller, uint8_t lsb, double time, uint8_t channel, std::vector<Parameter> &out);
+    void flush(ChannelState &state, uint8_t controller, uint8_t channel, std::vector<Parameter> &out);
+};
+
+// The reverse of ParameterAssembler: encodes parameter changes as controller
+// messages, leaving out the RPN/NRPN selection when the channel already has
+// the same parameter selected.
+class ParameterEncoder
+{
+public:
+    ParameterEncoder();
+
+    // Appends the messages to bytes, and the length of each to sizes
+    void encode(ParameterAssembler::Kind kind, uint8_t channel, uint16_t param, uint16_t value, std::vector<unsigned char> &bytes, std::vector<size_t> &sizes);
+
+    // Watch raw outgoing messages for selections made behind our back
+    void observe(const unsigned char *message, size_t length);
+
+    void reset();
+
+private:
+    // Kind and parameter number selected on each channel, or -1 when unknown
+    int32_t selected[16];
+};
+
+#endif // NODE_MIDI_PARAMS_H
@@ -0,0 +1,264 @@
+#include <algorithm>
+
+#include "pattern.h"
+
+PatternEngine::PatternEngine() : random(std::random_device{}())
+{
+}
+
+void PatternEngine::setPattern(Pattern newPattern)
+{
+    if (!running)
+    {
+        pattern = std::move(newPattern);
+        return;
+    }
+
+    pending = std::move(newPattern);
+    hasPending = true;
+}
+
+void PatternEngine::seed(uint32_t value)
+{
+    random.seed(value);
+}
+
+void PatternEngine::start(Clock::time_point now)
+{
+    if (running)
+    {
+        return;
+    }
+
+    running = true;
+    step = 0;
+    anchor = now;
+    anchorStep = 0;
+    arpIndex = 0;
+}
+
+void PatternEngine::stop(std::vector<Message> &out)
+{
+    while (!sounding.empty())
+    {
+        noteOff(sounding.size() - 1, out);
+    }
+
+    running = false;
+    if (hasPending)
+    {
+        pattern = std::move(pending);
+        hasPending = false;
+    }
+}
+
+void PatternEngine::played(const unsigned char *message, size_t length)
+{
+    if (length < 3)
+    {
+        return;
+    }
+
+    uint8_t type = message[0] & 0xF0;
+    if (type != 0x80 && type != 0x90)
+    {
+        return;
+    }
+
+    uint8_t channel = message[0] & 0x0F;
+    uint8_t note = message[1];
+    std::vector<Held>::iterator it = std::find_if(held.begin(), held.end(), [channel, note](const Held &h) { return h.channel == channel && h.note == note; });
+
+    if (type == 0x90 && message[2] > 0)
+    {
+        if (it == held.end())
+        {
+            held.push_back({channel, note, message[2]});
+        }
+    }
+    else if (it != held.end())
+    {
+        held.erase(it);
+    }
+}
+
+PatternEngine::Clock::duration PatternEngine::stepLength() const
+{
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(60.0 / (pattern.tempo * pattern.division)));
+}
+
+PatternEngine::Clock::time_point PatternEngine::unswungTime(uint64_t index) const
+{
+    return anchor + stepLength() * static_cast<int64_t>(index - anchorStep);
+}
+
+PatternEngine::Clock::time_point PatternEngine::stepTime(uint64_t index) const
+{
+    Clock::time_point time = unswungTime(index);
+    if (index & 1)
+    {
+        time += std::chrono::duration_cast<Clock::duration>(stepLength() * pattern.swing);
+    }
+    return time;
+}
+
+PatternEngine::Clock::time_point PatternEngine::advance(Clock::time_point now, std::vector<Message> &out)
+{
+    for (;;)
+    {
+        std::vector<Sounding>::iterator first = std::min_element(sounding.begin(), sounding.end(), [](const Sounding &a, const Sounding &b) { return a.off < b.off; });
+        Clock::time_point nextOff = first == sounding.end() ? Clock::time_point::max() : first->off;
+        Clock::time_point nextStep = running ? stepTime(step) : Clock::time_point::max();
+
+        // Note offs go first, so a note can end and start again on the same tick
+        if (nextOff <= now && nextOff <= nextStep)
+        {
+            noteOff(first - sounding.begin(), out);
+            continue;
+        }
+
+        if (nextStep > now)
+        {
+            return std::min(nextOff, nextStep);
+        }
+
+        if (hasPending)
+        {
+            // Carry on from this step's place in the old pattern
+            anchor = unswungTime(step);
+            anchorStep = step;
+            pattern = std::move(pending);
+            hasPending = false;
+            continue;
+        }
+
+        // Drop steps we were too late for rather than playing them in a burst
+        if (now - nextStep < stepLength())
+        {
+            play(nextStep, out);
+        }
+        step++;
+    }
+}
+
+void PatternEngine::play(Clock::time_point time, std::vector<Message> &out)
+{
+    Step current;
+    if (!pattern.steps.empty())
+    {
+        current = pattern.steps[step % pattern.steps.size()];
+    }
+    else if (pattern.mode != Steps)
+    {
+        current.velocity = 0;
+    }
+
+    if (current.rest)
+    {
+        return;
+    }
+
+    if (current.probability < 1 && std::uniform_real_distribution<double>(0, 1)(random) >= current.probability)
+    {
+        return;
+    }
+
+    uint8_t note = current.note;
+    uint8_t velocity = current.velocity;
+    if (pattern.mode != Steps)
+    {
+        uint8_t heldVelocity;
+        if (!nextArpNote(note, heldVelocity))
+        {
+            return;
+        }
+        if (velocity == 0)
+        {
+            velocity = heldVelocity;
+        }
+    }
+
+    if (velocity == 0)
+    {
+        return;
+    }
+
+    // Restrike rather than let the earlier note off cut this one short
+    for (size_t i = 0; i < sounding.size(); i++)
+    {
+        if (sounding[i].note == note && sounding[i].channel == pattern.channel)
+        {
+            noteOff(i, out);
+            break;
+        }
+    }
+
+    double gate = current.gate >= 0 ? current.gate : pattern.gate;
+    out.push_back({static_cast<unsigned char>(0x90 | pattern.channel), note, velocity});
+    sounding.push_back({time + std::chrono::duration_cast<Clock::duration>(stepLength() * gate), pattern.channel, note});
+}
+
+void PatternEngine::noteOff(size_t index, std::vector<Message> &out)
+{
+    out.push_back({static_cast<unsigned char>(0x80 | sounding[index].channel), sounding[index].note, 0});
+    sounding.erase(sounding.begin() + index);
+}
+
+bool PatternEngine::nextArpNote(uint8_t &note, uint8_t &velocity)
+{
+    if (held.empty())
+    {
+        return false;
+    }
+
+    // Rebuilt each step, as held notes come and go between steps
+    std::vector<Held> notes = held;
+    if (pattern.mode != Played)
+    {
+        std::sort(notes.begin(), notes.end(), [](const Held &a, const Held &b) { return a.note < b.note; });
+    }
+
+    std::vector<uint8_t> sequence;
+    std::vector<uint8_t> velocities;
+    for (unsigned int octave = 0; octave < pattern.octaves; octave++)
+    {
+        for (const Held &h : notes)
+        {
+            int transposed = h.note + 12 * octave;
+            if (transposed <= 127)
+            {
+                sequence.push_back(static_cast<uint8_t>(transposed));
+                velocities.push_back(h.velocity);
+            }
+        }
+    }
+
+    if (pattern.mode == Down)
+    {
+        std::reverse(sequence.begin(), sequence.end());
+        std::reverse(velocities.begin(), velocities.end());
+    }
+    else if (pattern.mode == UpDown && sequence.size() > 2)
+    {
+        // Up then back down, without repeating the top and bottom notes
+        for (size_t i = sequence.size() - 2; i > 0; i--)
+        {
+            sequence.push_back(sequence[i]);
+            velocities.push_back(velocities[i]);
+        }
+    }
+
+    size_t index;
+    if (pattern.mode == Random)
+    {
+        index = std::uniform_int_distribution<size_t>(0, sequence.size() - 1)(random);
+    }
+    else
+    {
+        index = arpIndex++ % sequence.size();
+    }
+
+    note = sequence[index];
+    velocity = velocities[index];
+    return true;
+}
@@ -0,0 +1,120 @@
+#ifndef NODE_MIDI_PATTERN_H
+#define NODE_MIDI_PATTERN_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Plays a step pattern, or arpeggiates the notes being held, against the
+// clock. Step times are worked out from when the pattern started rather
+// than from the previous step, so a late wakeup doesn't push back the steps
+// after it. A new pattern takes over at the next step boundary, so tempo
+// and steps always change together.
+class PatternEngine
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Message = std::array<unsigned char, 3>;
+
+    enum Mode
+    {
+        Steps,
+        Up,
+        Down,
+        UpDown,
+        Random,
+        Played,
+    };
+
+    struct Step
+    {
+        // Ignored when arpeggiating
+        uint8_t note = 60;
+        // 0 takes the velocity of the held note when arpeggiating
+        uint8_t velocity = 100;
+        bool rest = false;
+        double probability = 1;
+        // Fraction of the step the note is held for, or < 0 for the pattern's
+        double gate = -1;
+    };
+
+    struct Pattern
+    {
+        double tempo = 120;
+        // Steps per beat
+        unsigned int division = 4;
+        // Delay of every second step, as a fraction of a step
+        double swing = 0;
+        double gate = 0.5;
+        uint8_t channel = 0;
+        Mode mode = Steps;
+        // Octaves an arpeggio spans
+        unsigned int octaves = 1;
+        // When empty every step plays
+        std::vector<Step> steps;
+    };
+
+    PatternEngine();
+
+    // Takes effect at the next step boundary, or straight away when stopped
+    void setPattern(Pattern pattern);
+    void seed(uint32_t value);
+
+    void start(Clock::time_point now);
+    // Appends note offs for everything still sounding
+    void stop(std::vector<Message> &out);
+    bool isRunning() const { return running; }
+    uint64_t getStep() const { return step; }
+
+    // Follow the notes played on an input. A note is held until its note off
+    // arrives on the same channel.
+    void played(const unsigned char *message, size_t length);
+
+    // Appends the messages due by now, and returns when it next needs to run
+    Clock::time_point advance(Clock::time_point now, std::vector<Message> &out);
+
+private:
+    struct Sounding
+    {
+        Clock::time_point off;
+        uint8_t channel;
+        uint8_t note;
+    };
+
+    struct Held
+    {
+        uint8_t channel;
+        uint8_t note;
+        uint8_t velocity;
+    };
+
+    Pattern pattern;
+    Pattern pending;
+    bool hasPending = false;
+
+    bool running = false;
+    uint64_t step = 0;
+    // Unswung time of anchorStep, moved whenever the tempo may have changed
+    Clock::time_point anchor;
+    uint64_t anchorStep = 0;
+
+    // In the order they were played
+    std::vector<Held> held;
+    size_t arpIndex = 0;
+
+    std::vector<Sounding> sounding;
+    std::mt19937 random;
+
+    Clock::duration stepLength() const;
+    Clock::time_point unswungTime(uint64_t index) const;
+    Clock::time_point stepTime(uint64_t index) const;
+
+    void play(Clock::time_point time, std::vector<Message> &out);
+    void noteOff(size_t index, std::vector<Message> &out);
+    bool nextArpNote(uint8_t &note, uint8_t &velocity);
+};
+
+#endif // NODE_MIDI_PATTERN_H
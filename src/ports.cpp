@@ -0,0 +1,116 @@
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "ports.h"
+
+RtMidi::Api parseApi(const std::string &name)
+{
+    if (name == "winmm") return RtMidi::WINDOWS_MM;
+    if (name == "uwp") return RtMidi::WINDOWS_UWP;
+    if (name == "core") return RtMidi::MACOSX_CORE;
+    if (name == "alsa") return RtMidi::LINUX_ALSA;
+    if (name == "jack") return RtMidi::UNIX_JACK;
+    if (name == "loopback") return RtMidi::RTMIDI_LOOPBACK;
+    if (name == "shm") return RtMidi::RTMIDI_SHM;
+    if (name == "rtp") return RtMidi::RTMIDI_RTP;
+    return RtMidi::UNSPECIFIED;
+}
+
+namespace
+{
+    struct Clients
+    {
+        std::mutex mutex;
+        std::map<RtMidi::Api, std::unique_ptr<RtMidiIn>> inputs;
+        std::map<RtMidi::Api, std::unique_ptr<RtMidiOut>> outputs;
+    };
+
+    Clients &clients()
+    {
+        // Deliberately leaked, so the clients outlive any late finalisers
+        static Clients *instance = new Clients();
+        return *instance;
+    }
+
+    // Called with the mutex held
+    template <typename T>
+    T &client(std::map<RtMidi::Api, std::unique_ptr<T>> &cache, RtMidi::Api api)
+    {
+        std::unique_ptr<T> &found = cache[api];
+        if (!found)
+        {
+            found.reset(new T(api));
+        }
+        return *found;
+    }
+}
+
+unsigned int PortEnumerator::inputCount(RtMidi::Api api)
+{
+    std::lock_guard<std::mutex> lock(clients().mutex);
+    return client(clients().inputs, api).getPortCount();
+}
+
+std::string PortEnumerator::inputName(RtMidi::Api api, unsigned int port)
+{
+    std::lock_guard<std::mutex> lock(clients().mutex);
+    return client(clients().inputs, api).getPortName(port);
+}
+
+unsigned int PortEnumerator::outputCount(RtMidi::Api api)
+{
+    std::lock_guard<std::mutex> lock(clients().mutex);
+    return client(clients().outputs, api).getPortCount();
+}
+
+std::string PortEnumerator::outputName(RtMidi::Api api, unsigned int port)
+{
+    std::lock_guard<std::mutex> lock(clients().mutex);
+    return client(clients().outputs, api).getPortName(port);
+}
+
+void PortEnumerator::Init(const Napi::Env &env, Napi::Object exports)
+{
+    exports.Set("listInputs", Napi::Function::New(env, &PortEnumerator::ListInputs, "listInputs"));
+    exports.Set("listOutputs", Napi::Function::New(env, &PortEnumerator::ListOutputs, "listOutputs"));
+}
+
+static Napi::Value listPorts(const Napi::CallbackInfo &info, unsigned int (*count)(RtMidi::Api), std::string (*name)(RtMidi::Api, unsigned int))
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    RtMidi::Api api = RtMidi::UNSPECIFIED;
+    if (info.Length() >= 1 && info[0].IsString())
+    {
+        api = parseApi(info[0].ToString().Utf8Value());
+    }
+
+    try
+    {
+        unsigned int ports = count(api);
+
+        Napi::Array names = Napi::Array::New(env, ports);
+        for (unsigned int port = 0; port < ports; port++)
+        {
+            names.Set(port, Napi::String::New(env, name(api, port)));
+        }
+        return names;
+    }
+    catch (RtMidiError &e)
+    {
+        Napi::Error::New(env, "Failed to initialise RtMidi").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+Napi::Value PortEnumerator::ListInputs(const Napi::CallbackInfo &info)
+{
+    return listPorts(info, &PortEnumerator::inputCount, &PortEnumerator::inputName);
+}
+
+Napi::Value PortEnumerator::ListOutputs(const Napi::CallbackInfo &info)
+{
+    return listPorts(info, &PortEnumerator::outputCount, &PortEnumerator::outputName);
+}
@@ -0,0 +1,32 @@
+#ifndef NODE_MIDI_PORTS_H
+#define NODE_MIDI_PORTS_H
+
+#include <napi.h>
+#include <string>
+#include <vector>
+
+#include "RtMidi.h"
+
+RtMidi::Api parseApi(const std::string &name);
+
+// Lists ports without a port object of its own. Creating an RtMidi client
+// is expensive on some APIs (ALSA opens a sequencer client and allocates a
+// queue), so one input and one output client per API are created on first
+// use and kept for the life of the process, shared by every caller.
+class PortEnumerator
+{
+public:
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    // Throw RtMidiError if the API can't be initialised
+    static unsigned int inputCount(RtMidi::Api api);
+    static std::string inputName(RtMidi::Api api, unsigned int port);
+    static unsigned int outputCount(RtMidi::Api api);
+    static std::string outputName(RtMidi::Api api, unsigned int port);
+
+private:
+    static Napi::Value ListInputs(const Napi::CallbackInfo &info);
+    static Napi::Value ListOutputs(const Napi::CallbackInfo &info);
+};
+
+#endif // NODE_MIDI_PORTS_H
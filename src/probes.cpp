@@ -0,0 +1,11 @@
+#include "probes.h"
+
+#if defined(NODE_MIDI_HAS_PROBES)
+
+// The tracer finds the semaphores through the probe notes and increments
+// them in the process while attached
+#define NODE_MIDI_PROBE_DEFINE(name) unsigned short node_midi_##name##_semaphore __attribute__((section(".probes"), used)) = 0;
+
+NODE_MIDI_PROBES(NODE_MIDI_PROBE_DEFINE)
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef NODE_MIDI_PROBES_H
+#define NODE_MIDI_PROBES_H
+
+// USDT tracepoints on the hot paths, under the provider "node_midi", for
+// tracing a running process with bpftrace or perf. Each probe has a
+// semaphore which the tracer raises while attached, so the arguments are
+// only evaluated while something is listening and a disabled probe costs a
+// predicted branch. Without <sys/sdt.h> the probes compile away.
+//
+// Times are CLOCK_MONOTONIC nanoseconds, so probes can be compared.
+//
+//   alsa_receive(client, port, size, time)        event read from ALSA, by source address
+//   input_enqueue(port, size, time)               NodeMidiInput::Callback
+//   input_dispatch(port, size, time, queued)      CallbackJs, queued is the enqueue time
+//   output_send_entry(port, size, time)           NodeMidiOutput::Send and SendUmp
+//   output_send_return(port, size, time, ok)
+//   alsa_send_entry(port, size, time)             MidiOutAlsa::sendMessage, by ALSA port
+//   alsa_send_return(port, size, time, ok)
+//
+// Node-midi port numbers are the ones used by the flight recorder.
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define NODE_MIDI_HAS_PROBES 1
+#endif
+#endif
+
+#include <stdint.h>
+
+#if defined(NODE_MIDI_HAS_PROBES)
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <time.h>
+
+#define NODE_MIDI_PROBE_SEMAPHORE(name) extern unsigned short node_midi_##name##_semaphore;
+#define NODE_MIDI_PROBES(X) \
+    X(alsa_receive)         \
+    X(input_enqueue)        \
+    X(input_dispatch)       \
+    X(output_send_entry)    \
+    X(output_send_return)   \
+    X(alsa_send_entry)      \
+    X(alsa_send_return)
+
+NODE_MIDI_PROBES(NODE_MIDI_PROBE_SEMAPHORE)
+
+#define NODE_MIDI_PROBE_ENABLED(name) __builtin_expect(node_midi_##name##_semaphore != 0, 0)
+
+#define NODE_MIDI_PROBE(name, ...)                     \
+    do                                                 \
+    {                                                  \
+        if (NODE_MIDI_PROBE_ENABLED(name))             \
+        {                                              \
+            STAP_PROBEV(node_midi, name, __VA_ARGS__); \
+        }                                              \
+    } while (0)
+
+static inline uint64_t nodeMidiProbeTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000u + static_cast<uint64_t>(now.tv_nsec);
+}
+
+#else
+
+// The arguments are still named in dead code, so values kept only for a
+// probe don't warn as unused
+static inline void nodeMidiProbeDiscard(...)
+{
+}
+
+#define NODE_MIDI_PROBE_ENABLED(name) false
+#define NODE_MIDI_PROBE(name, ...)             \
+    do                                         \
+    {                                          \
+        if (false)                             \
+        {                                      \
+            nodeMidiProbeDiscard(__VA_ARGS__); \
+        }                                      \
+    } while (0)
+
+static inline uint64_t nodeMidiProbeTime()
+{
+    return 0;
+}
+
+#endif
+
+#endif // NODE_MIDI_PROBES_H
@@ -0,0 +1,285 @@
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "recorder.h"
+
+static const char RECORDER_MAGIC[4] = {'N', 'M', 'F', 'R'};
+static const uint32_t RECORDER_VERSION = 1;
+static const size_t RECORDER_MIN_SIZE = 4096;
+
+// The header is shared with readers in other processes, so its counters
+// must be plain 64-bit words
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Recorder counters must be 64 bits");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Recorder counters must be lock free");
+
+static uint64_t alignRecord(uint64_t size)
+{
+    return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+void FlightRecorder::Init(const Napi::Env &env, Napi::Object exports)
+{
+    exports.Set("startRecorder", Napi::Function::New(env, &FlightRecorder::Start, "startRecorder"));
+    exports.Set("stopRecorder", Napi::Function::New(env, &FlightRecorder::Stop, "stopRecorder"));
+}
+
+FlightRecorder &FlightRecorder::instance()
+{
+    // Deliberately leaked, so recording from late finalisers stays safe
+    static FlightRecorder *recorder = new FlightRecorder();
+    return *recorder;
+}
+
+uint16_t FlightRecorder::nextPort()
+{
+    static std::atomic<uint16_t> counter{0};
+    return counter++;
+}
+
+FlightRecorder::FlightRecorder()
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    close();
+}
+
+bool FlightRecorder::open(const std::string &path, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    enabled = false;
+    unmap();
+
+    size = size & ~static_cast<size_t>(7);
+    if (size < RECORDER_MIN_SIZE)
+    {
+        size = RECORDER_MIN_SIZE;
+    }
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr);
+    if (mappingHandle == nullptr)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, size);
+    if (view == nullptr)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    file = fileHandle;
+    mapping = mappingHandle;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if (ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    file = fd;
+#endif
+
+    mappedSize = size;
+    header = static_cast<Header *>(view);
+    ring = static_cast<unsigned char *>(view) + sizeof(Header);
+
+    // Carry on from an earlier run when the layout matches, so a restart
+    // after a crash doesn't wipe the records leading up to it
+    uint64_t capacity = size - sizeof(Header);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    if (memcmp(header->magic, RECORDER_MAGIC, sizeof(RECORDER_MAGIC)) != 0 || header->version != RECORDER_VERSION || header->capacity != capacity || tail > head || head - tail > capacity)
+    {
+        memcpy(header->magic, RECORDER_MAGIC, sizeof(RECORDER_MAGIC));
+        header->version = RECORDER_VERSION;
+        header->capacity = capacity;
+        memset(header->reserved, 0, sizeof(header->reserved));
+        header->head.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_release);
+    }
+
+    enabled = true;
+    return true;
+}
+
+void FlightRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    enabled = false;
+    unmap();
+}
+
+void FlightRecorder::unmap()
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    FlushViewOfFile(header, mappedSize);
+    UnmapViewOfFile(header);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    msync(header, mappedSize, MS_ASYNC);
+    munmap(header, mappedSize);
+    ::close(file);
+    file = -1;
+#endif
+
+    header = nullptr;
+    ring = nullptr;
+    mappedSize = 0;
+}
+
+void FlightRecorder::write(uint64_t offset, const void *data, size_t length)
+{
+    uint64_t capacity = header->capacity;
+    size_t position = offset % capacity;
+    size_t first = length < capacity - position ? length : capacity - position;
+
+    memcpy(ring + position, data, first);
+    memcpy(ring, static_cast<const unsigned char *>(data) + first, length - first);
+}
+
+void FlightRecorder::read(uint64_t offset, void *data, size_t length) const
+{
+    uint64_t capacity = header->capacity;
+    size_t position = offset % capacity;
+    size_t first = length < capacity - position ? length : capacity - position;
+
+    memcpy(data, ring + position, first);
+    memcpy(static_cast<unsigned char *>(data) + first, ring, length - first);
+}
+
+void FlightRecorder::record(uint16_t port, Direction direction, const unsigned char *message, size_t length)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    Record record;
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.length = static_cast<uint32_t>(length);
+    record.port = port;
+    record.direction = direction;
+    record.reserved = 0;
+
+    uint64_t size = alignRecord(sizeof(Record) + length);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (header == nullptr || size > header->capacity)
+    {
+        return;
+    }
+
+    // Drop the oldest records to make room. tail is published before their
+    // space is reused, and head only after the new record is complete, so a
+    // crash mid-write never leaves a torn record between tail and head.
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    while (tail < head && head + size - tail > header->capacity)
+    {
+        Record oldest;
+        read(tail, &oldest, sizeof(Record));
+
+        // The file may have been left corrupt by an earlier run, so never
+        // trust a length that reaches past head. Empty the ring instead.
+        uint64_t oldestSize = alignRecord(sizeof(Record) + static_cast<uint64_t>(oldest.length));
+        if (oldestSize > head - tail)
+        {
+            tail = head;
+            break;
+        }
+        tail += oldestSize;
+    }
+    header->tail.store(tail, std::memory_order_release);
+
+    write(head, &record, sizeof(Record));
+    write(head + sizeof(Record), message, length);
+
+    header->head.store(head + size, std::memory_order_release);
+}
+
+void FlightRecorder::record(uint16_t port, Direction direction, const std::string &name)
+{
+    record(port, direction, reinterpret_cast<const unsigned char *>(name.data()), name.size());
+}
+
+Napi::Value FlightRecorder::Start(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected a path and a size").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string path = info[0].ToString();
+    double size = info[1].ToNumber();
+    if (!(size > 0))
+    {
+        Napi::RangeError::New(env, "Size must be positive").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!instance().open(path, static_cast<size_t>(size)))
+    {
+        Napi::Error::New(env, "Failed to map recorder file").ThrowAsJavaScriptException();
+    }
+
+    return env.Null();
+}
+
+Napi::Value FlightRecorder::Stop(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    instance().close();
+
+    return env.Null();
+}
@@ -0,0 +1,98 @@
+#ifndef NODE_MIDI_RECORDER_H
+#define NODE_MIDI_RECORDER_H
+
+#include <napi.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Process-wide flight recorder, appending every message passing through any
+// port to a ring in a memory-mapped file. The mapping is shared with the
+// page cache, so the last records survive the process crashing. Records are
+// read back by lib/recorder.js.
+//
+// File layout, little-endian:
+//   Header (64 bytes): "NMFR", u32 version, u64 capacity, u64 head, u64 tail
+//   Ring (capacity bytes) of records, each 8-byte aligned and possibly
+//   wrapping around the end of the ring:
+//     u64 wall clock time in ns, u32 length, u16 port, u8 direction, u8 0,
+//     then length bytes of message
+// head and tail are byte offsets which only ever grow, taken modulo capacity
+// to find the position in the ring. Records between tail and head are valid.
+// Both are published with release stores: tail before its space is reused,
+// head only once the record behind it has been written.
+class FlightRecorder
+{
+public:
+    enum Direction : uint8_t
+    {
+        In = 0,
+        Out = 1,
+        // The message is the name of the port which was opened
+        OpenIn = 2,
+        OpenOut = 3,
+    };
+
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    static FlightRecorder &instance();
+
+    // Ports are numbered for the lifetime of the process
+    static uint16_t nextPort();
+
+    bool open(const std::string &path, size_t size);
+    void close();
+
+    bool isOpen() const { return enabled.load(std::memory_order_relaxed); }
+
+    void record(uint16_t port, Direction direction, const unsigned char *message, size_t length);
+    void record(uint16_t port, Direction direction, const std::string &name);
+
+private:
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t capacity;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        uint64_t reserved[4];
+    };
+
+    struct Record
+    {
+        uint64_t time;
+        uint32_t length;
+        uint16_t port;
+        uint8_t direction;
+        uint8_t reserved;
+    };
+
+    FlightRecorder();
+    ~FlightRecorder();
+
+    void write(uint64_t offset, const void *data, size_t length);
+    void read(uint64_t offset, void *data, size_t length) const;
+    void unmap();
+
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+
+    Header *header = nullptr;
+    unsigned char *ring = nullptr;
+    size_t mappedSize = 0;
+
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    static Napi::Value Start(const Napi::CallbackInfo &info);
+    static Napi::Value Stop(const Napi::CallbackInfo &info);
+};
+
+#endif // NODE_MIDI_RECORDER_H
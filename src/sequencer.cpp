@@ -0,0 +1,308 @@
+#include <napi.h>
+#include <cmath>
+
+#include "input.h"
+#include "midi.h"
+#include "output.h"
+#include "sequencer.h"
+
+namespace
+{
+    // Reads an optional number property, leaving value alone when it is missing
+    bool readNumber(const Napi::Env &env, const Napi::Object &object, const char *key, double min, double max, double &value)
+    {
+        Napi::Value property = object.Get(key);
+        if (property.IsUndefined())
+        {
+            return true;
+        }
+
+        double number = property.IsNumber() ? property.ToNumber().DoubleValue() : NAN;
+        if (!(number >= min && number <= max))
+        {
+            Napi::RangeError::New(env, std::string(key) + " is out of range").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        value = number;
+        return true;
+    }
+
+    bool readMode(const Napi::Env &env, const Napi::Object &object, PatternEngine::Mode &mode)
+    {
+        Napi::Value property = object.Get("mode");
+        if (property.IsUndefined())
+        {
+            return true;
+        }
+
+        static const char *names[] = {"steps", "up", "down", "updown", "random", "played"};
+        std::string name = property.IsString() ? property.ToString().Utf8Value() : "";
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            if (name == names[i])
+            {
+                mode = static_cast<PatternEngine::Mode>(i);
+                return true;
+            }
+        }
+
+        Napi::RangeError::New(env, "Unknown mode").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    bool readStep(const Napi::Env &env, const Napi::Value &value, PatternEngine::Step &step)
+    {
+        if (!value.IsObject())
+        {
+            Napi::TypeError::New(env, "Steps must be objects").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Object object = value.As<Napi::Object>();
+        double note = step.note;
+        double velocity = step.velocity;
+        if (!readNumber(env, object, "note", 0, 127, note) ||
+            !readNumber(env, object, "velocity", 0, 127, velocity) ||
+            !readNumber(env, object, "probability", 0, 1, step.probability) ||
+            !readNumber(env, object, "gate", 0, 1, step.gate))
+        {
+            return false;
+        }
+
+        step.note = static_cast<uint8_t>(note);
+        step.velocity = static_cast<uint8_t>(velocity);
+        step.rest = object.Get("rest").ToBoolean();
+        return true;
+    }
+}
+
+void NodeMidiSequencer::Init(const Napi::Env &env, Napi::Object exports)
+{
+    Napi::HandleScope scope(env);
+
+    Napi::Function func = DefineClass(env, "NodeMidiSequencer", {
+                                                                    InstanceMethod<&NodeMidiSequencer::SetPattern>("setPattern", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                    InstanceMethod<&NodeMidiSequencer::Start>("start", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                    InstanceMethod<&NodeMidiSequencer::Stop>("stop", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                    InstanceMethod<&NodeMidiSequencer::IsRunning>("isRunning", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                    InstanceMethod<&NodeMidiSequencer::GetStep>("getStep", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+
+                                                                    InstanceMethod<&NodeMidiSequencer::Follow>("follow", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                    InstanceMethod<&NodeMidiSequencer::Unfollow>("unfollow", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                });
+
+    exports.Set("Sequencer", func);
+}
+
+NodeMidiSequencer::NodeMidiSequencer(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeMidiSequencer>(info),
+      output(nullptr),
+      timer([this](DeadlineTimer::Clock::time_point now) { return tick(now); })
+{
+    Napi::Env env = info.Env();
+
+    MidiInstanceData *instanceData = env.GetInstanceData<MidiInstanceData>();
+    if (info.Length() == 0 || !info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(instanceData->output->Value()))
+    {
+        Napi::TypeError::New(env, "First argument must be an output").ThrowAsJavaScriptException();
+        return;
+    }
+
+    output = NodeMidiOutput::Unwrap(info[0].As<Napi::Object>());
+    outputRef = Napi::Persistent(info[0].As<Napi::Object>());
+}
+
+NodeMidiSequencer::~NodeMidiSequencer()
+{
+    timer.shutdown();
+    unfollow();
+
+    std::vector<PatternEngine::Message> messages;
+    engine.stop(messages);
+    send(messages);
+}
+
+DeadlineTimer::Clock::time_point NodeMidiSequencer::tick(DeadlineTimer::Clock::time_point now)
+{
+    std::vector<PatternEngine::Message> messages;
+    DeadlineTimer::Clock::time_point next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = engine.advance(now, messages);
+    }
+
+    send(messages);
+    return next;
+}
+
+void NodeMidiSequencer::send(const std::vector<PatternEngine::Message> &messages)
+{
+    if (!output)
+    {
+        return;
+    }
+
+    for (const PatternEngine::Message &message : messages)
+    {
+        output->sendRaw(message.data(), message.size());
+    }
+}
+
+void NodeMidiSequencer::played(const unsigned char *message, size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    engine.played(message, length);
+}
+
+void NodeMidiSequencer::unfollow()
+{
+    if (input)
+    {
+        input->unfollow(this);
+        input = nullptr;
+        inputRef.Reset();
+    }
+}
+
+Napi::Value NodeMidiSequencer::SetPattern(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "First argument must be a pattern").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Built in full before it goes near the engine, so a bad property leaves it unchanged
+    Napi::Object object = info[0].As<Napi::Object>();
+    PatternEngine::Pattern pattern;
+    double division = pattern.division;
+    double channel = pattern.channel;
+    double octaves = pattern.octaves;
+    double seed = -1;
+    if (!readNumber(env, object, "tempo", 1, 1000, pattern.tempo) ||
+        !readNumber(env, object, "division", 1, 96, division) ||
+        !readNumber(env, object, "swing", 0, 0.75, pattern.swing) ||
+        !readNumber(env, object, "gate", 0, 1, pattern.gate) ||
+        !readNumber(env, object, "channel", 0, 15, channel) ||
+        !readNumber(env, object, "octaves", 1, 8, octaves) ||
+        !readNumber(env, object, "seed", 0, UINT32_MAX, seed) ||
+        !readMode(env, object, pattern.mode))
+    {
+        return env.Null();
+    }
+    pattern.division = static_cast<unsigned int>(division);
+    pattern.channel = static_cast<uint8_t>(channel);
+    pattern.octaves = static_cast<unsigned int>(octaves);
+
+    Napi::Value steps = object.Get("steps");
+    if (!steps.IsUndefined())
+    {
+        if (!steps.IsArray())
+        {
+            Napi::TypeError::New(env, "Steps must be an array").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Array array = steps.As<Napi::Array>();
+        pattern.steps.resize(array.Length());
+        for (uint32_t i = 0; i < array.Length(); i++)
+        {
+            if (!readStep(env, array.Get(i), pattern.steps[i]))
+            {
+                return env.Null();
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    engine.setPattern(std::move(pattern));
+    if (seed >= 0)
+    {
+        engine.seed(static_cast<uint32_t>(seed));
+    }
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiSequencer::Start(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    DeadlineTimer::Clock::time_point now = DeadlineTimer::Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        engine.start(now);
+    }
+    timer.schedule(now);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiSequencer::Stop(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    std::vector<PatternEngine::Message> messages;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        engine.stop(messages);
+    }
+    send(messages);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiSequencer::IsRunning(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return Napi::Boolean::New(env, engine.isRunning());
+}
+
+Napi::Value NodeMidiSequencer::GetStep(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return Napi::Number::New(env, static_cast<double>(engine.getStep()));
+}
+
+Napi::Value NodeMidiSequencer::Follow(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    MidiInstanceData *instanceData = env.GetInstanceData<MidiInstanceData>();
+    if (info.Length() == 0 || !info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(instanceData->input->Value()))
+    {
+        Napi::TypeError::New(env, "First argument must be an input").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    unfollow();
+
+    input = NodeMidiInput::Unwrap(info[0].As<Napi::Object>());
+    inputRef = Napi::Persistent(info[0].As<Napi::Object>());
+    input->follow(this);
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiSequencer::Unfollow(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    unfollow();
+
+    return env.Null();
+}
@@ -0,0 +1,55 @@
+#ifndef NODE_MIDI_SEQUENCER_H
+#define NODE_MIDI_SEQUENCER_H
+
+#include <napi.h>
+#include <mutex>
+
+#include "pattern.h"
+#include "timer.h"
+
+class NodeMidiInput;
+class NodeMidiOutput;
+
+// Plays a PatternEngine through an output from its own timer thread, so
+// steps keep time however busy the JS thread is.
+class NodeMidiSequencer : public Napi::ObjectWrap<NodeMidiSequencer>
+{
+private:
+    // Kept alive for as long as the sequencer can send through it
+    NodeMidiOutput *output;
+    Napi::ObjectReference outputRef;
+
+    // The input whose held notes are arpeggiated, if any
+    NodeMidiInput *input = nullptr;
+    Napi::ObjectReference inputRef;
+
+    // Guards the engine, which the timer, input and JS threads all use
+    std::mutex mutex;
+    PatternEngine engine;
+
+    // Declared last, so its thread is stopped before the state it touches is destroyed
+    DeadlineTimer timer;
+
+    DeadlineTimer::Clock::time_point tick(DeadlineTimer::Clock::time_point now);
+    void send(const std::vector<PatternEngine::Message> &messages);
+    void unfollow();
+
+public:
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    NodeMidiSequencer(const Napi::CallbackInfo &info);
+    ~NodeMidiSequencer();
+
+    // Called on the input thread with each message the followed input receives
+    void played(const unsigned char *message, size_t length);
+
+    Napi::Value SetPattern(const Napi::CallbackInfo &info);
+    Napi::Value Start(const Napi::CallbackInfo &info);
+    Napi::Value Stop(const Napi::CallbackInfo &info);
+    Napi::Value IsRunning(const Napi::CallbackInfo &info);
+    Napi::Value GetStep(const Napi::CallbackInfo &info);
+    Napi::Value Follow(const Napi::CallbackInfo &info);
+    Napi::Value Unfollow(const Napi::CallbackInfo &info);
+};
+
+#endif // NODE_MIDI_SEQUENCER_H
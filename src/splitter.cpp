@@ -0,0 +1,267 @@
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NODE_MIDI_SPLIT_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NODE_MIDI_SPLIT_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "splitter.h"
+
+namespace
+{
+    // Data bytes following a channel voice status, indexed by the upper nibble minus 8
+    const uint8_t channelDataBytes[7] = {2, 2, 2, 2, 1, 1, 2};
+
+    // Data bytes following a system common status, indexed by the lower
+    // nibble. F4 and F5 are undefined and have no data, F6 has none either.
+    const uint8_t systemDataBytes[8] = {0, 1, 2, 1, 0, 0, 0, 0};
+
+#if defined(NODE_MIDI_SPLIT_SSE2)
+    inline unsigned int lowestBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+#endif
+
+    // Index of the first status byte in data, or length if there is none
+    size_t findStatus(const unsigned char *data, size_t length)
+    {
+        size_t i = 0;
+
+#if defined(NODE_MIDI_SPLIT_SSE2)
+        // The sign bit of each byte is exactly the status bit
+        for (; i + 16 <= length; i += 16)
+        {
+            unsigned int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+            if (mask != 0)
+            {
+                return i + lowestBit(mask);
+            }
+        }
+#elif defined(NODE_MIDI_SPLIT_NEON)
+        for (; i + 16 <= length; i += 16)
+        {
+            if (vmaxvq_u8(vld1q_u8(data + i)) & 0x80)
+            {
+                break;
+            }
+        }
+#endif
+
+        for (; i < length; i++)
+        {
+            if (data[i] & 0x80)
+            {
+                return i;
+            }
+        }
+        return length;
+    }
+
+    void emit(MidiSplitter::Result &result, const unsigned char *message, size_t length)
+    {
+        result.offsets.push_back(static_cast<uint32_t>(result.bytes.size()));
+        result.lengths.push_back(static_cast<uint32_t>(length));
+        result.bytes.insert(result.bytes.end(), message, message + length);
+    }
+}
+
+void MidiSplitter::Init(const Napi::Env &env, Napi::Object exports)
+{
+    exports.Set("splitMessages", Napi::Function::New(env, &MidiSplitter::SplitMessages, "splitMessages"));
+}
+
+void MidiSplitter::split(const unsigned char *data, size_t length, Result &result)
+{
+    result.bytes.reserve(result.bytes.size() + length);
+
+    // The channel status to reuse for data bytes without one of their own
+    unsigned char running = 0;
+
+    // A channel or system common message being collected
+    unsigned char pending[3];
+    size_t pendingLength = 0;
+    size_t needed = 0;
+    // pending[0] came from running status rather than the stream, so isn't counted when dropped
+    size_t pendingSynthesized = 0;
+
+    // Sysex is collected apart, so realtime bytes inside it can go first
+    bool inSysex = false;
+    std::vector<unsigned char> sysex;
+
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned char byte = data[i];
+
+        if (byte < 0x80)
+        {
+            if (inSysex)
+            {
+                size_t run = findStatus(data + i, length - i);
+                sysex.insert(sysex.end(), data + i, data + i + run);
+                i += run;
+                continue;
+            }
+
+            if (pendingLength == 0)
+            {
+                if (running == 0)
+                {
+                    // Nothing to attach these to
+                    size_t run = findStatus(data + i, length - i);
+                    result.dropped += run;
+                    i += run;
+                    continue;
+                }
+
+                pending[0] = running;
+                pendingLength = 1;
+                pendingSynthesized = 1;
+                needed = 1 + channelDataBytes[(running >> 4) - 8];
+            }
+
+            pending[pendingLength++] = byte;
+            if (pendingLength == needed)
+            {
+                emit(result, pending, needed);
+                pendingLength = 0;
+            }
+            i++;
+            continue;
+        }
+
+        i++;
+
+        // Realtime bytes may appear anywhere, and don't disturb what they interrupt
+        if (byte >= 0xF8)
+        {
+            emit(result, &byte, 1);
+            continue;
+        }
+
+        // Any other status ends an unfinished message
+        if (pendingLength > 0)
+        {
+            result.dropped += pendingLength - pendingSynthesized;
+            pendingLength = 0;
+        }
+
+        if (byte == 0xF7)
+        {
+            if (inSysex)
+            {
+                sysex.push_back(byte);
+                emit(result, sysex.data(), sysex.size());
+                inSysex = false;
+            }
+            else
+            {
+                result.dropped++;
+            }
+            continue;
+        }
+
+        if (inSysex)
+        {
+            result.dropped += sysex.size();
+            inSysex = false;
+        }
+
+        if (byte == 0xF0)
+        {
+            running = 0;
+            inSysex = true;
+            sysex.assign(1, byte);
+        }
+        else if (byte > 0xF0)
+        {
+            running = 0;
+            if (byte == 0xF4 || byte == 0xF5)
+            {
+                result.dropped++;
+            }
+            else if (byte == 0xF6)
+            {
+                emit(result, &byte, 1);
+            }
+            else
+            {
+                pending[0] = byte;
+                pendingLength = 1;
+                pendingSynthesized = 0;
+                needed = 1 + systemDataBytes[byte & 0x0F];
+            }
+        }
+        else
+        {
+            running = byte;
+            pending[0] = byte;
+            pendingLength = 1;
+            pendingSynthesized = 0;
+            needed = 1 + channelDataBytes[(byte >> 4) - 8];
+        }
+    }
+
+    // A message cut off by the end of the stream
+    if (pendingLength > 0)
+    {
+        result.dropped += pendingLength - pendingSynthesized;
+    }
+    if (inSysex)
+    {
+        result.dropped += sysex.size();
+    }
+}
+
+Napi::Value MidiSplitter::SplitMessages(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    if (info.Length() == 0 || !info[0].IsBuffer())
+    {
+        Napi::TypeError::New(env, "First argument must be a buffer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
+    if (buffer.Length() > UINT32_MAX)
+    {
+        Napi::RangeError::New(env, "Buffer is too large").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Result split;
+    MidiSplitter::split(buffer.Data(), buffer.Length(), split);
+
+    size_t count = split.offsets.size();
+    Napi::ArrayBuffer offsets = Napi::ArrayBuffer::New(env, count * sizeof(uint32_t));
+    Napi::ArrayBuffer lengths = Napi::ArrayBuffer::New(env, count * sizeof(uint32_t));
+    if (count > 0)
+    {
+        memcpy(offsets.Data(), split.offsets.data(), count * sizeof(uint32_t));
+        memcpy(lengths.Data(), split.lengths.data(), count * sizeof(uint32_t));
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("data", Napi::Buffer<unsigned char>::Copy(env, split.bytes.data(), split.bytes.size()));
+    result.Set("offsets", Napi::Uint32Array::New(env, count, offsets, 0));
+    result.Set("lengths", Napi::Uint32Array::New(env, count, lengths, 0));
+    result.Set("dropped", Napi::Number::New(env, static_cast<double>(split.dropped)));
+
+    return result;
+}
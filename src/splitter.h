@@ -0,0 +1,35 @@
+#ifndef NODE_MIDI_SPLITTER_H
+#define NODE_MIDI_SPLITTER_H
+
+#include <napi.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Splits a raw MIDI 1.0 byte stream, as read from a file dump or a serial
+// link, into complete messages. Running status is expanded, realtime bytes
+// are pulled out of the messages they interrupt, and anything which isn't
+// part of a complete message is dropped. Runs of data bytes, which make up
+// most of a sysex dump, are skipped over with SIMD where it is available.
+class MidiSplitter
+{
+public:
+    struct Result
+    {
+        // The messages back to back, in the order they completed
+        std::vector<unsigned char> bytes;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> lengths;
+        // Bytes which were not part of a complete message
+        size_t dropped = 0;
+    };
+
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    static void split(const unsigned char *data, size_t length, Result &result);
+
+private:
+    static Napi::Value SplitMessages(const Napi::CallbackInfo &info);
+};
+
+#endif // NODE_MIDI_SPLITTER_H
@@ -0,0 +1,188 @@
+#include <mutex>
+#include <set>
+
+#include "stats.h"
+
+namespace
+{
+    struct Registry
+    {
+        std::mutex mutex;
+        std::set<const PortStats *> live;
+        // Totals of the ports which have been destroyed
+        PortStats::Snapshot retired;
+    };
+
+    Registry &registry()
+    {
+        // Deliberately leaked, as ports can be finalised after static destructors run
+        static Registry *instance = new Registry();
+        return *instance;
+    }
+}
+
+void PortStats::Init(const Napi::Env &env, Napi::Object exports)
+{
+    exports.Set("getStats", Napi::Function::New(env, &PortStats::GetProcessStats, "getStats"));
+}
+
+PortStats::PortStats()
+{
+    for (std::atomic<uint64_t> &counter : counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+
+    Registry &stats = registry();
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    stats.live.insert(this);
+}
+
+PortStats::~PortStats()
+{
+    Registry &stats = registry();
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    stats.live.erase(this);
+
+    // Nothing is waiting in a destroyed port's queue
+    int64_t depth = stats.retired.queueDepth;
+    addTo(stats.retired);
+    stats.retired.queueDepth = depth;
+}
+
+void PortStats::received(const unsigned char *message, size_t length)
+{
+    add(MessagesIn);
+    add(BytesIn, length);
+    if (length > 0 && message[0] == 0xF0)
+    {
+        add(Sysex);
+    }
+}
+
+void PortStats::sent(const unsigned char *bytes, const size_t *sizes, size_t count)
+{
+    size_t total = 0;
+    uint64_t sysex = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sizes[i] > 0 && bytes[total] == 0xF0)
+        {
+            sysex++;
+        }
+        total += sizes[i];
+    }
+
+    add(MessagesOut, count);
+    add(BytesOut, total);
+    if (sysex > 0)
+    {
+        add(Sysex, sysex);
+    }
+    add(Writes);
+    add(Batches);
+    add(BatchedMessages, count);
+}
+
+void PortStats::enqueued()
+{
+    add(TsfnCalls);
+
+    uint64_t depth = static_cast<uint64_t>(queueDepth.fetch_add(1, std::memory_order_relaxed) + 1);
+    uint64_t highest = maxQueueDepth.load(std::memory_order_relaxed);
+    while (depth > highest && !maxQueueDepth.compare_exchange_weak(highest, depth, std::memory_order_relaxed))
+    {
+    }
+}
+
+void PortStats::dequeued()
+{
+    add(BatchedMessages);
+
+    // The JS thread drains the queue in one go, so a batch ends when it empties
+    if (queueDepth.fetch_sub(1, std::memory_order_relaxed) == 1)
+    {
+        add(Batches);
+    }
+}
+
+void PortStats::rejected()
+{
+    add(DroppedClosed);
+    queueDepth.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void PortStats::addTo(Snapshot &snapshot) const
+{
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        snapshot.counters[i] += counters[i].load(std::memory_order_relaxed);
+    }
+
+    snapshot.queueDepth += queueDepth.load(std::memory_order_relaxed);
+
+    uint64_t highest = maxQueueDepth.load(std::memory_order_relaxed);
+    if (highest > snapshot.maxQueueDepth)
+    {
+        snapshot.maxQueueDepth = highest;
+    }
+}
+
+Napi::Object PortStats::toObject(const Napi::Env &env) const
+{
+    Snapshot snapshot;
+    addTo(snapshot);
+    return toObject(env, snapshot);
+}
+
+Napi::Object PortStats::toObject(const Napi::Env &env, const Snapshot &snapshot)
+{
+    const uint64_t *counts = snapshot.counters;
+
+    // Counts stay well inside the 2^53 a double holds exactly
+    auto number = [&env](uint64_t value) { return Napi::Number::New(env, static_cast<double>(value)); };
+
+    Napi::Object dropped = Napi::Object::New(env);
+    dropped.Set("closed", number(counts[DroppedClosed]));
+    dropped.Set("conversion", number(counts[DroppedConversion]));
+    dropped.Set("send", number(counts[DroppedSend]));
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("messagesIn", number(counts[MessagesIn]));
+    result.Set("bytesIn", number(counts[BytesIn]));
+    result.Set("messagesOut", number(counts[MessagesOut]));
+    result.Set("bytesOut", number(counts[BytesOut]));
+    result.Set("sysex", number(counts[Sysex]));
+    result.Set("dropped", dropped);
+    result.Set("queueDepth", number(snapshot.queueDepth > 0 ? snapshot.queueDepth : 0));
+    result.Set("maxQueueDepth", number(snapshot.maxQueueDepth));
+    result.Set("tsfnCalls", number(counts[TsfnCalls]));
+    result.Set("averageBatchSize", Napi::Number::New(env, counts[Batches] > 0 ? static_cast<double>(counts[BatchedMessages]) / counts[Batches] : 0));
+    result.Set("writes", number(counts[Writes]));
+    result.Set("encodeErrors", number(counts[EncodeErrors]));
+    result.Set("overruns", number(counts[Overruns]));
+    result.Set("thinned", number(counts[Thinned]));
+    result.Set("coalesced", number(counts[Coalesced]));
+
+    return result;
+}
+
+Napi::Value PortStats::GetProcessStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    Snapshot snapshot;
+    {
+        Registry &stats = registry();
+        std::lock_guard<std::mutex> lock(stats.mutex);
+
+        snapshot = stats.retired;
+        for (const PortStats *port : stats.live)
+        {
+            port->addTo(snapshot);
+        }
+    }
+
+    return toObject(env, snapshot);
+}
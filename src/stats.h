@@ -0,0 +1,92 @@
+#ifndef NODE_MIDI_STATS_H
+#define NODE_MIDI_STATS_H
+
+#include <napi.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Counters for one port, updated with relaxed atomics from whichever thread
+// the event happens on and read from JS by getStats(). Every live port is
+// registered so the process-wide totals can be summed on demand, and its
+// counts are folded into those totals when it is destroyed.
+class PortStats
+{
+public:
+    enum Counter
+    {
+        MessagesIn,
+        BytesIn,
+        MessagesOut,
+        BytesOut,
+        Sysex,
+        // Events the TSFN refused, because the port was closing
+        DroppedClosed,
+        // Messages which could not be converted to UMP
+        DroppedConversion,
+        // Sends which RtMidi raised an error for
+        DroppedSend,
+        TsfnCalls,
+        // Messages handled in batches, and the number of batches: calls into
+        // the backend on output, and runs of CallbackJs which drained the
+        // queue on input
+        BatchedMessages,
+        Batches,
+        // Calls into the backend send path
+        Writes,
+        EncodeErrors,
+        // Times the driver's input buffer overflowed, losing an unknown number of events
+        Overruns,
+        // Controller changes dropped or held back by thinning
+        Thinned,
+        // Output controller changes dropped for a newer value
+        Coalesced,
+        COUNTER_COUNT
+    };
+
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    PortStats();
+    ~PortStats();
+
+    PortStats(const PortStats &) = delete;
+    PortStats &operator=(const PortStats &) = delete;
+
+    void add(Counter counter, uint64_t count = 1)
+    {
+        counters[counter].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void received(const unsigned char *message, size_t length);
+    // One backend write of count messages, packed back to back in bytes
+    void sent(const unsigned char *bytes, const size_t *sizes, size_t count);
+
+    // Track events waiting for the JS thread
+    void enqueued();
+    void dequeued();
+    // The TSFN refused an event counted by enqueued()
+    void rejected();
+    // The queue was aborted along with anything waiting in it
+    void clearQueue() { queueDepth.store(0, std::memory_order_relaxed); }
+
+    Napi::Object toObject(const Napi::Env &env) const;
+
+    struct Snapshot
+    {
+        uint64_t counters[COUNTER_COUNT] = {};
+        int64_t queueDepth = 0;
+        uint64_t maxQueueDepth = 0;
+    };
+
+private:
+    void addTo(Snapshot &snapshot) const;
+    static Napi::Object toObject(const Napi::Env &env, const Snapshot &snapshot);
+
+    static Napi::Value GetProcessStats(const Napi::CallbackInfo &info);
+
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<int64_t> queueDepth{0};
+    std::atomic<uint64_t> maxQueueDepth{0};
+};
+
+#endif // NODE_MIDI_STATS_H
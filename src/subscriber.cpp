@@ -0,0 +1,144 @@
+#include <napi.h>
+
+#include "subscriber.h"
+
+void NodeMidiSubscriber::Init(const Napi::Env &env, Napi::Object exports)
+{
+    Napi::HandleScope scope(env);
+
+    Napi::Function func = DefineClass(env, "NodeMidiSubscriber", {
+                                                                     InstanceMethod<&NodeMidiSubscriber::Close>("close", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                     InstanceMethod<&NodeMidiSubscriber::GetLost>("getLost", static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                                                 });
+
+    exports.Set("Subscriber", func);
+}
+
+NodeMidiSubscriber::NodeMidiSubscriber(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<NodeMidiSubscriber>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 3 || !info[0].IsString() || !info[1].IsNumber() || !info[2].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected a hub name, a capacity and a callback").ThrowAsJavaScriptException();
+        return;
+    }
+
+    double capacity = info[1].ToNumber();
+    if (!(capacity > 0))
+    {
+        Napi::RangeError::New(env, "Capacity must be positive").ThrowAsJavaScriptException();
+        return;
+    }
+
+    wakeReleased = new bool(false);
+
+    wake = TSFN_t::New(
+        env,
+        info[2].As<Napi::Function>(),
+        "Midi Subscriber",
+        0,
+        1,
+        this,
+        [](Napi::Env, bool *released, NodeMidiSubscriber *ctx) {
+            // Gone with its worker, which can be well before the subscriber is.
+            // Once we released it ourselves, ctx may already be gone.
+            if (!*released)
+            {
+                ctx->unsubscribe();
+            }
+            delete released;
+        },
+        wakeReleased);
+
+    hub = MessageHub::get(info[0].ToString().Utf8Value(), static_cast<size_t>(capacity));
+
+    NodeMidiSubscriber *subscriber = this;
+    cursor = hub->subscribe([subscriber]() {
+        if (!subscriber->woken.exchange(true))
+        {
+            subscriber->wake.NonBlockingCall(nullptr);
+        }
+    },
+                            id);
+    subscribed = true;
+
+    // Never holds the process open, not even with messages waiting to be
+    // read, so whatever publishes to the hub has to keep it alive
+    wake.Unref(env);
+}
+
+NodeMidiSubscriber::~NodeMidiSubscriber()
+{
+    release();
+}
+
+void NodeMidiSubscriber::release()
+{
+    if (subscribed)
+    {
+        unsubscribe();
+        // Anything still queued is dropped, rather than called with us gone
+        *wakeReleased = true;
+        wake.Abort();
+        wake.Release();
+    }
+}
+
+void NodeMidiSubscriber::unsubscribe()
+{
+    // Once this returns the writer can't touch wake any more
+    if (subscribed)
+    {
+        hub->unsubscribe(id);
+        subscribed = false;
+    }
+}
+
+void NodeMidiSubscriber::CallbackJs(Napi::Env env, Napi::Function callback, NodeMidiSubscriber *context, void *)
+{
+    if (env == nullptr || callback == nullptr || !context->subscribed)
+    {
+        return;
+    }
+
+    // Cleared first, so anything published while we read wakes us again
+    context->woken = false;
+
+    std::vector<unsigned char> message;
+    double time;
+    uint64_t lost;
+    while (context->subscribed && context->hub->read(context->cursor, message, time, lost))
+    {
+        if (lost > 0)
+        {
+            context->lost += lost;
+            callback.Call({Napi::Number::New(env, static_cast<double>(lost)), env.Undefined(), Napi::String::New(env, "lag")});
+        }
+
+        // Publishers' stream times restart when they reopen
+        double deltaTime = time > context->lastTime ? time - context->lastTime : 0;
+        context->lastTime = time;
+
+        callback.Call({Napi::Number::New(env, deltaTime), Napi::Buffer<unsigned char>::Copy(env, message.data(), message.size())});
+    }
+}
+
+Napi::Value NodeMidiSubscriber::Close(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    release();
+
+    return env.Null();
+}
+
+Napi::Value NodeMidiSubscriber::GetLost(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+
+    return Napi::Number::New(env, static_cast<double>(lost));
+}
@@ -0,0 +1,47 @@
+#ifndef NODE_MIDI_SUBSCRIBER_H
+#define NODE_MIDI_SUBSCRIBER_H
+
+#include <napi.h>
+#include <atomic>
+#include <memory>
+
+#include "hub.h"
+
+// Reads the messages published to a MessageHub on the JS thread it was
+// created on. The publishing thread only wakes it once per batch, however
+// many messages arrive before it gets round to reading them.
+class NodeMidiSubscriber : public Napi::ObjectWrap<NodeMidiSubscriber>
+{
+private:
+    static void CallbackJs(Napi::Env env, Napi::Function callback, NodeMidiSubscriber *context, void *data);
+    using TSFN_t = Napi::TypedThreadSafeFunction<NodeMidiSubscriber, void, CallbackJs>;
+
+    std::shared_ptr<MessageHub> hub;
+    MessageHub::Cursor cursor;
+    uint64_t id = 0;
+    bool subscribed = false;
+
+    TSFN_t wake;
+    // Owned by the TSFN finalizer, set once we have released the TSFN
+    bool *wakeReleased = nullptr;
+    // Set while a wakeup is queued, so the writer doesn't queue another
+    std::atomic<bool> woken{false};
+
+    double lastTime = 0;
+    uint64_t lost = 0;
+
+    void unsubscribe();
+    // Unsubscribes and lets the TSFN go, after which it never touches us
+    void release();
+
+public:
+    static void Init(const Napi::Env &env, Napi::Object exports);
+
+    NodeMidiSubscriber(const Napi::CallbackInfo &info);
+    ~NodeMidiSubscriber();
+
+    Napi::Value Close(const Napi::CallbackInfo &info);
+    Napi::Value GetLost(const Napi::CallbackInfo &info);
+};
+
+#endif // NODE_MIDI_SUBSCRIBER_H
@@ -0,0 +1,245 @@
+#include <algorithm>
+
+#include "sysex.h"
+
+// Sample Dump Standard handshake sub IDs, sent as F0 7E <device> <sub ID> <packet> F7
+static const unsigned char HANDSHAKE_WAIT = 0x7C;
+static const unsigned char HANDSHAKE_CANCEL = 0x7D;
+static const unsigned char HANDSHAKE_NAK = 0x7E;
+static const unsigned char HANDSHAKE_ACK = 0x7F;
+
+static const uint32_t NO_MATCH = UINT32_MAX;
+
+SysexMatcher::SysexMatcher()
+{
+}
+
+SysexMatcher::~SysexMatcher()
+{
+}
+
+void SysexMatcher::add(uint32_t id, Request request, Clock::time_point now)
+{
+    // Without a pattern only a handshake can settle the request, so keep it
+    // out of the trie where it would match everything
+    if (!request.pattern.empty())
+    {
+        Node *node = &root;
+        for (int16_t byte : request.pattern)
+        {
+            auto child = std::find_if(node->children.begin(), node->children.end(),
+                                      [byte](const std::pair<int16_t, std::unique_ptr<Node>> &edge) { return edge.first == byte; });
+            if (child == node->children.end())
+            {
+                node->children.emplace_back(byte, std::unique_ptr<Node>(new Node()));
+                child = node->children.end() - 1;
+            }
+            node = child->second.get();
+        }
+        node->ids.push_back(id);
+    }
+
+    Entry entry;
+    entry.deadline = now + request.timeout;
+    entry.request = std::move(request);
+    requests.emplace(id, std::move(entry));
+}
+
+void SysexMatcher::remove(uint32_t id)
+{
+    auto found = requests.find(id);
+    if (found == requests.end())
+    {
+        return;
+    }
+
+    const std::vector<int16_t> &pattern = found->second.request.pattern;
+    if (pattern.empty())
+    {
+        requests.erase(found);
+        return;
+    }
+
+    // Remember the path, so nodes left empty can be pruned on the way back up
+    std::vector<Node *> path{&root};
+    for (int16_t byte : pattern)
+    {
+        Node *node = path.back();
+        auto child = std::find_if(node->children.begin(), node->children.end(),
+                                  [byte](const std::pair<int16_t, std::unique_ptr<Node>> &edge) { return edge.first == byte; });
+        path.push_back(child->second.get());
+    }
+
+    std::vector<uint32_t> &ids = path.back()->ids;
+    ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+    for (size_t depth = pattern.size(); depth > 0; depth--)
+    {
+        Node *node = path[depth];
+        if (!node->ids.empty() || !node->children.empty())
+        {
+            break;
+        }
+
+        std::vector<std::pair<int16_t, std::unique_ptr<Node>>> &siblings = path[depth - 1]->children;
+        siblings.erase(std::find_if(siblings.begin(), siblings.end(),
+                                    [node](const std::pair<int16_t, std::unique_ptr<Node>> &edge) { return edge.second.get() == node; }));
+    }
+
+    requests.erase(found);
+}
+
+void SysexMatcher::collect(const Node &node, const unsigned char *message, size_t length, size_t depth, uint32_t &best) const
+{
+    // Every node reached is a pattern which prefixes the message
+    for (uint32_t id : node.ids)
+    {
+        best = std::min(best, id);
+    }
+
+    if (depth == length)
+    {
+        return;
+    }
+
+    for (const std::pair<int16_t, std::unique_ptr<Node>> &edge : node.children)
+    {
+        if (edge.first < 0 || edge.first == message[depth])
+        {
+            collect(*edge.second, message, length, depth + 1, best);
+        }
+    }
+}
+
+bool SysexMatcher::handleHandshake(const unsigned char *message, Clock::time_point now, std::vector<Outcome> &out)
+{
+    unsigned char device = message[2];
+
+    // Handshakes carry no request ID, so they belong to the oldest request
+    // expecting one from this device
+    auto found = std::find_if(requests.begin(), requests.end(), [device](const std::pair<const uint32_t, Entry> &entry) {
+        const Request &request = entry.second.request;
+        if (!request.handshake)
+        {
+            return false;
+        }
+
+        // Only universal messages name the device they are talking to
+        if (request.message.size() < 3 || request.message[1] != 0x7E)
+        {
+            return true;
+        }
+
+        return device == 0x7F || request.message[2] == 0x7F || request.message[2] == device;
+    });
+
+    if (found == requests.end())
+    {
+        return false;
+    }
+
+    uint32_t id = found->first;
+    Entry &entry = found->second;
+
+    switch (message[3])
+    {
+    case HANDSHAKE_ACK:
+        if (entry.request.pattern.empty())
+        {
+            // Nothing more to wait for
+            out.push_back({Outcome::Response, id, std::vector<unsigned char>(message, message + 6)});
+            remove(id);
+        }
+        else
+        {
+            entry.deadline = now + entry.request.timeout;
+        }
+        break;
+
+    case HANDSHAKE_NAK:
+        if (entry.request.retries > 0 && entry.request.resend)
+        {
+            entry.request.retries--;
+            entry.deadline = now + entry.request.timeout;
+            entry.request.resend(entry.request.message);
+        }
+        else
+        {
+            out.push_back({Outcome::Rejected, id, std::vector<unsigned char>(message, message + 6)});
+            remove(id);
+        }
+        break;
+
+    case HANDSHAKE_WAIT:
+        // The device will follow up with another handshake in its own time,
+        // but give up on one that never does
+        entry.deadline = now + entry.request.waitTimeout;
+        break;
+
+    case HANDSHAKE_CANCEL:
+        out.push_back({Outcome::Cancelled, id, std::vector<unsigned char>(message, message + 6)});
+        remove(id);
+        break;
+    }
+
+    return true;
+}
+
+bool SysexMatcher::process(const unsigned char *message, size_t length, Clock::time_point now, std::vector<Outcome> &out)
+{
+    if (requests.empty() || length < 2 || message[0] != 0xF0)
+    {
+        return false;
+    }
+
+    if (length == 6 && message[1] == 0x7E && message[3] >= HANDSHAKE_WAIT && message[5] == 0xF7)
+    {
+        if (handleHandshake(message, now, out))
+        {
+            return true;
+        }
+    }
+
+    uint32_t best = NO_MATCH;
+    collect(root, message, length, 0, best);
+    if (best == NO_MATCH)
+    {
+        return false;
+    }
+
+    out.push_back({Outcome::Response, best, std::vector<unsigned char>(message, message + length)});
+    remove(best);
+
+    return true;
+}
+
+SysexMatcher::Clock::time_point SysexMatcher::expire(Clock::time_point now, std::vector<Outcome> &out)
+{
+    Clock::time_point next = Clock::time_point::max();
+
+    for (auto entry = requests.begin(); entry != requests.end();)
+    {
+        uint32_t id = entry->first;
+        Clock::time_point deadline = entry->second.deadline;
+        ++entry;
+
+        if (deadline <= now)
+        {
+            out.push_back({Outcome::Timeout, id, std::vector<unsigned char>()});
+            remove(id);
+        }
+        else if (deadline < next)
+        {
+            next = deadline;
+        }
+    }
+
+    return next;
+}
+
+void SysexMatcher::clear()
+{
+    root.children.clear();
+    root.ids.clear();
+    requests.clear();
+}
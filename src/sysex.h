@@ -0,0 +1,87 @@
+#ifndef NODE_MIDI_SYSEX_H
+#define NODE_MIDI_SYSEX_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Matches incoming sysex against pending requests, using a prefix trie of
+// their response patterns. Requests can opt in to the Sample Dump Standard
+// handshake (ACK/NAK/WAIT/CANCEL), which is then handled without a round
+// trip through JS.
+class SysexMatcher
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Resend = std::function<void(const std::vector<unsigned char> &message)>;
+
+    // A pattern byte of -1 matches any byte
+    struct Request
+    {
+        std::vector<int16_t> pattern;
+        std::vector<unsigned char> message;
+        Clock::duration timeout;
+        // Longest the device may hold the request with WAIT
+        Clock::duration waitTimeout;
+        bool handshake = false;
+        int retries = 0;
+        Resend resend;
+    };
+
+    struct Outcome
+    {
+        enum Type
+        {
+            Response,
+            Timeout,
+            Rejected,
+            Cancelled,
+        };
+
+        Type type;
+        uint32_t id;
+        std::vector<unsigned char> message;
+    };
+
+    SysexMatcher();
+    ~SysexMatcher();
+
+    void add(uint32_t id, Request request, Clock::time_point now);
+    void remove(uint32_t id);
+    bool isEmpty() const { return requests.empty(); }
+
+    // Returns true when the message settled or advanced a request, in which
+    // case it should not be emitted as an ordinary message
+    bool process(const unsigned char *message, size_t length, Clock::time_point now, std::vector<Outcome> &out);
+
+    // Fails requests whose deadline passed, and returns the next deadline
+    Clock::time_point expire(Clock::time_point now, std::vector<Outcome> &out);
+
+    void clear();
+
+private:
+    struct Node
+    {
+        std::vector<std::pair<int16_t, std::unique_ptr<Node>>> children;
+        std::vector<uint32_t> ids;
+    };
+
+    struct Entry
+    {
+        Request request;
+        Clock::time_point deadline;
+    };
+
+    Node root;
+    // Ordered by id, so the first entry is the oldest request
+    std::map<uint32_t, Entry> requests;
+
+    void collect(const Node &node, const unsigned char *message, size_t length, size_t depth, uint32_t &best) const;
+    bool handleHandshake(const unsigned char *message, Clock::time_point now, std::vector<Outcome> &out);
+};
+
+#endif // NODE_MIDI_SYSEX_H
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "thinning.h"
+
+// Bank select, data entry, increment and decrement, parameter numbers and
+// channel mode, where every message matters and dropping one would change
+// what the rest mean
+static bool isThinnable(int controller)
+{
+    return !(controller == 0 || controller == 32 || controller == 6 || controller == 38 ||
+             (controller >= 96 && controller <= 101) || (controller >= 120 && controller < ControllerThinner::PitchBend));
+}
+
+ControllerThinner::ControllerThinner()
+{
+    configure({});
+}
+
+void ControllerThinner::configure(const std::vector<Rule> &rules)
+{
+    for (int channel = 0; channel < 16; channel++)
+    {
+        for (int controller = 0; controller < Controllers; controller++)
+        {
+            settings[channel][controller] = {false, 0, 0, Clock::duration::zero()};
+        }
+    }
+
+    for (const Rule &rule : rules)
+    {
+        for (int channel = 0; channel < 16; channel++)
+        {
+            if (rule.channel >= 0 && rule.channel != channel)
+            {
+                continue;
+            }
+
+            for (int controller = 0; controller < Controllers; controller++)
+            {
+                bool matches = rule.controller < 0 ? controller < PitchBend && isThinnable(controller) : rule.controller == controller;
+                if (matches)
+                {
+                    settings[channel][controller] = {true, static_cast<uint16_t>(rule.deadband), static_cast<uint16_t>(rule.hysteresis), rule.interval};
+                }
+            }
+        }
+    }
+
+    enabled = !rules.empty();
+    reset();
+}
+
+void ControllerThinner::reset()
+{
+    for (int channel = 0; channel < 16; channel++)
+    {
+        for (int controller = 0; controller < Controllers; controller++)
+        {
+            State &state = states[channel][controller];
+            state.last = -1;
+            state.direction = 0;
+            state.lastSent = Clock::time_point::min();
+            state.held = false;
+        }
+    }
+
+    heldCount = 0;
+}
+
+bool ControllerThinner::process(const unsigned char *message, size_t length, double time, Clock::time_point now, Clock::time_point &deadline)
+{
+    if (length < 2)
+    {
+        return false;
+    }
+
+    int controller;
+    int32_t value;
+    int32_t maximum;
+    switch (message[0] & 0xF0)
+    {
+    case 0xB0:
+        if (length != 3)
+        {
+            return false;
+        }
+        controller = message[1];
+        value = message[2];
+        maximum = 127;
+        break;
+    case 0xD0:
+        controller = Pressure;
+        value = message[1];
+        maximum = 127;
+        break;
+    case 0xE0:
+        if (length != 3)
+        {
+            return false;
+        }
+        controller = PitchBend;
+        value = message[1] | message[2] << 7;
+        maximum = 16383;
+        break;
+    default:
+        return false;
+    }
+
+    uint8_t channel = message[0] & 0x0F;
+    const Settings &setting = settings[channel][controller];
+    if (!setting.active)
+    {
+        return false;
+    }
+
+    State &state = states[channel][controller];
+    if (state.last >= 0)
+    {
+        int32_t change = value - state.last;
+        if (change == 0)
+        {
+            return true;
+        }
+
+        int8_t direction = change > 0 ? 1 : -1;
+        uint32_t size = static_cast<uint32_t>(std::abs(change));
+        uint32_t threshold = setting.deadband;
+        if (state.direction != 0 && direction != state.direction)
+        {
+            threshold = std::max<uint32_t>(threshold, setting.hysteresis);
+        }
+
+        // The ends of the range always get through, so a control can be put all the way down
+        bool end = value == 0 || value == maximum;
+        if (size < threshold && !end)
+        {
+            return true;
+        }
+
+        state.direction = direction;
+    }
+    state.last = value;
+
+    if (setting.interval > Clock::duration::zero() && state.lastSent != Clock::time_point::min() && now - state.lastSent < setting.interval)
+    {
+        if (!state.held)
+        {
+            state.held = true;
+            heldCount++;
+        }
+        memcpy(state.message.bytes, message, length);
+        state.message.length = length;
+        state.message.time = time;
+        deadline = state.lastSent + setting.interval;
+        return true;
+    }
+
+    // A newer value makes the held one redundant
+    if (state.held)
+    {
+        state.held = false;
+        heldCount--;
+    }
+    state.lastSent = now;
+    return false;
+}
+
+ControllerThinner::Clock::time_point ControllerThinner::expire(Clock::time_point now, std::vector<Message> &out)
+{
+    Clock::time_point next = Clock::time_point::max();
+    if (heldCount == 0)
+    {
+        return next;
+    }
+
+    for (int channel = 0; channel < 16; channel++)
+    {
+        for (int controller = 0; controller < Controllers; controller++)
+        {
+            State &state = states[channel][controller];
+            if (!state.held)
+            {
+                continue;
+            }
+
+            Clock::time_point due = state.lastSent + settings[channel][controller].interval;
+            if (due <= now)
+            {
+                out.push_back(state.message);
+                state.held = false;
+                state.lastSent = now;
+                heldCount--;
+            }
+            else
+            {
+                next = std::min(next, due);
+            }
+        }
+    }
+
+    return next;
+}
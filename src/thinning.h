@@ -0,0 +1,88 @@
+#ifndef NODE_MIDI_THINNING_H
+#define NODE_MIDI_THINNING_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Thins out controller, pitch bend and channel pressure traffic from noisy
+// hardware. Each channel and controller can have a deadband, hysteresis for
+// changes of direction, and a maximum rate. Values held back by the rate
+// limit are replaced by newer ones, and the last is sent once the interval
+// is up, so the final position is never lost.
+class ControllerThinner
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Controller numbers above the CCs
+    static const int PitchBend = 128;
+    static const int Pressure = 129;
+    static const int Controllers = 130;
+
+    struct Rule
+    {
+        // -1 for every channel
+        int channel = -1;
+        // A CC number, PitchBend or Pressure, or -1 for every CC but bank
+        // select, the parameter controllers and channel mode
+        int controller = -1;
+        // Changes smaller than this are dropped
+        unsigned int deadband = 0;
+        // Changes of direction smaller than this are dropped
+        unsigned int hysteresis = 0;
+        // Zero for no limit
+        Clock::duration interval = Clock::duration::zero();
+    };
+
+    struct Message
+    {
+        unsigned char bytes[3];
+        size_t length;
+        // Stream time of the message which was held
+        double time;
+    };
+
+    ControllerThinner();
+
+    // Later rules take precedence over earlier ones. Discards any held values.
+    void configure(const std::vector<Rule> &rules);
+    bool isEnabled() const { return enabled; }
+
+    // Returns true when the message was dropped or held back. When it was
+    // held, deadline is set to when it is due to be sent.
+    bool process(const unsigned char *message, size_t length, double time, Clock::time_point now, Clock::time_point &deadline);
+
+    // Appends the held values which are due, and returns the next deadline
+    Clock::time_point expire(Clock::time_point now, std::vector<Message> &out);
+
+    void reset();
+
+private:
+    struct Settings
+    {
+        bool active;
+        uint16_t deadband;
+        uint16_t hysteresis;
+        Clock::duration interval;
+    };
+
+    struct State
+    {
+        // The last value let through, whether sent or held, or -1
+        int32_t last;
+        // Sign of the last change let through
+        int8_t direction;
+        Clock::time_point lastSent;
+        bool held;
+        Message message;
+    };
+
+    bool enabled = false;
+    Settings settings[16][Controllers];
+    State states[16][Controllers];
+    size_t heldCount = 0;
+};
+
+#endif // NODE_MIDI_THINNING_H
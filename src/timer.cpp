@@ -0,0 +1,91 @@
+#include "timer.h"
+
+DeadlineTimer::DeadlineTimer(Callback callback) : callback(std::move(callback))
+{
+}
+
+DeadlineTimer::~DeadlineTimer()
+{
+    shutdown();
+}
+
+void DeadlineTimer::schedule(Clock::time_point deadline)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (stopping || shutDown)
+    {
+        return;
+    }
+
+    if (!thread.joinable())
+    {
+        thread = std::thread(&DeadlineTimer::run, this);
+    }
+
+    if (deadline < next)
+    {
+        next = deadline;
+        wake.notify_one();
+    }
+}
+
+void DeadlineTimer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        wake.notify_one();
+    }
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    next = Clock::time_point::max();
+}
+
+void DeadlineTimer::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutDown = true;
+    }
+
+    stop();
+}
+
+void DeadlineTimer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!stopping)
+    {
+        if (next == Clock::time_point::max())
+        {
+            wake.wait(lock);
+            continue;
+        }
+
+        if (wake.wait_until(lock, next) != std::cv_status::timeout && Clock::now() < next)
+        {
+            // Woken early, either for an earlier deadline or to stop
+            continue;
+        }
+
+        next = Clock::time_point::max();
+
+        // The callback takes its own locks, so never run it under ours
+        lock.unlock();
+        Clock::time_point requested = callback(Clock::now());
+        lock.lock();
+
+        if (requested < next)
+        {
+            next = requested;
+        }
+    }
+}
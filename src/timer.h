@@ -0,0 +1,46 @@
+#ifndef NODE_MIDI_TIMER_H
+#define NODE_MIDI_TIMER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs a callback on a background thread whenever a scheduled deadline
+// passes. The callback returns the next deadline it needs, or
+// time_point::max() when it has nothing pending. The thread is only started
+// on the first call to schedule().
+class DeadlineTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<Clock::time_point(Clock::time_point now)>;
+
+    explicit DeadlineTimer(Callback callback);
+    ~DeadlineTimer();
+
+    // Ensure the callback runs no later than the given deadline
+    void schedule(Clock::time_point deadline);
+
+    // Stop the thread, dropping any scheduled deadline. A later schedule()
+    // starts it again.
+    void stop();
+
+    // Stop the thread for good, for use while the owner is being destroyed
+    void shutdown();
+
+private:
+    void run();
+
+    Callback callback;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    Clock::time_point next = Clock::time_point::max();
+    bool stopping = false;
+    bool shutDown = false;
+    std::thread thread;
+};
+
+#endif // NODE_MIDI_TIMER_H
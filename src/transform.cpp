@@ -0,0 +1,230 @@
+#include <algorithm>
+
+#include "transform.h"
+
+namespace
+{
+    inline unsigned int opcodeOf(uint32_t word) { return word & 0xFF; }
+    inline unsigned int regA(uint32_t word) { return (word >> 8) & 0x0F; }
+    inline unsigned int regB(uint32_t word) { return (word >> 12) & 0x0F; }
+    inline int immediate(uint32_t word) { return static_cast<int16_t>(word >> 16); }
+
+    // Arithmetic wraps like the hardware does, rather than overflowing
+    inline int32_t wrap(uint32_t value) { return static_cast<int32_t>(value); }
+}
+
+uint32_t TransformVm::encode(Opcode op, unsigned int a, unsigned int b, int imm)
+{
+    return static_cast<uint32_t>(op) | (a & 0x0F) << 8 | (b & 0x0F) << 12 | static_cast<uint32_t>(static_cast<uint16_t>(imm)) << 16;
+}
+
+bool TransformVm::load(std::vector<uint32_t> newCode, std::vector<std::vector<int32_t>> newTables, size_t targets, std::string &error)
+{
+    for (const std::vector<int32_t> &table : newTables)
+    {
+        if (table.empty())
+        {
+            error = "Lookup tables must not be empty";
+            return false;
+        }
+    }
+
+    size_t size = newCode.size();
+    for (size_t pc = 0; pc < size; pc++)
+    {
+        uint32_t word = newCode[pc];
+        unsigned int op = opcodeOf(word);
+        int imm = immediate(word);
+
+        if (op >= OpcodeCount)
+        {
+            error = "Unknown opcode at instruction " + std::to_string(pc);
+            return false;
+        }
+
+        switch (op)
+        {
+        case Lookup:
+            if (imm < 0 || static_cast<size_t>(imm) >= newTables.size())
+            {
+                error = "Missing lookup table at instruction " + std::to_string(pc);
+                return false;
+            }
+            break;
+        case Jump:
+        case JumpEq:
+        case JumpNe:
+        case JumpLt:
+        case JumpGt:
+            // Jumping to the end is allowed, and stops the program
+            if (imm < 1 || pc + imm > size)
+            {
+                error = "Jump out of range at instruction " + std::to_string(pc);
+                return false;
+            }
+            break;
+        case Forward:
+        case Emit:
+            if (imm < 0 || static_cast<size_t>(imm) > targets)
+            {
+                error = "Missing output at instruction " + std::to_string(pc);
+                return false;
+            }
+            if (op == Emit && (regB(word) < 1 || regB(word) > 3 || regA(word) + regB(word) > Registers))
+            {
+                error = "Invalid message length at instruction " + std::to_string(pc);
+                return false;
+            }
+            break;
+        }
+    }
+
+    code = std::move(newCode);
+    tables = std::move(newTables);
+    return true;
+}
+
+void TransformVm::clear()
+{
+    code.clear();
+    tables.clear();
+}
+
+void TransformVm::run(const unsigned char *message, size_t length, std::vector<Emitted> &out) const
+{
+    if (length == 0 || length > 3)
+    {
+        return;
+    }
+
+    int32_t r[Registers] = {0};
+    r[0] = message[0];
+    r[1] = length > 1 ? message[1] : 0;
+    r[2] = length > 2 ? message[2] : 0;
+    r[3] = static_cast<int32_t>(length);
+    r[4] = message[0] < 0xF0 ? message[0] & 0x0F : -1;
+    r[5] = message[0] < 0xF0 ? message[0] & 0xF0 : message[0];
+
+    // Every jump goes forwards, so this always terminates
+    size_t size = code.size();
+    size_t pc = 0;
+    while (pc < size)
+    {
+        uint32_t word = code[pc];
+        int32_t &a = r[regA(word)];
+        int32_t b = r[regB(word)];
+        int imm = immediate(word);
+
+        switch (opcodeOf(word))
+        {
+        case End:
+            return;
+        case LoadI:
+            a = imm;
+            break;
+        case Mov:
+            a = b;
+            break;
+        case Add:
+            a = wrap(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+            break;
+        case Sub:
+            a = wrap(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+            break;
+        case Mul:
+            a = wrap(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+            break;
+        case Div:
+            a = (b == 0 || (b == -1 && a == INT32_MIN)) ? 0 : a / b;
+            break;
+        case And:
+            a &= b;
+            break;
+        case Or:
+            a |= b;
+            break;
+        case Shl:
+            a = wrap(static_cast<uint32_t>(a) << (b & 31));
+            break;
+        case Shr:
+            a >>= (b & 31);
+            break;
+        case Min:
+            a = std::min(a, b);
+            break;
+        case Max:
+            a = std::max(a, b);
+            break;
+        case AddI:
+            a = wrap(static_cast<uint32_t>(a) + static_cast<uint32_t>(imm));
+            break;
+        case Lookup:
+        {
+            const std::vector<int32_t> &table = tables[imm];
+            size_t index = a < 0 ? 0 : std::min(static_cast<size_t>(a), table.size() - 1);
+            a = table[index];
+            break;
+        }
+        case Jump:
+            pc += imm;
+            continue;
+        case JumpEq:
+            if (a == b)
+            {
+                pc += imm;
+                continue;
+            }
+            break;
+        case JumpNe:
+            if (a != b)
+            {
+                pc += imm;
+                continue;
+            }
+            break;
+        case JumpLt:
+            if (a < b)
+            {
+                pc += imm;
+                continue;
+            }
+            break;
+        case JumpGt:
+            if (a > b)
+            {
+                pc += imm;
+                continue;
+            }
+            break;
+        case Forward:
+        {
+            Emitted emitted;
+            emitted.target = static_cast<uint16_t>(imm);
+            emitted.length = static_cast<uint8_t>(length);
+            std::copy(message, message + length, emitted.bytes);
+            out.push_back(emitted);
+            break;
+        }
+        case Emit:
+        {
+            // A computed status outside the status range sends nothing
+            if (a < 0x80 || a > 0xFF)
+            {
+                break;
+            }
+
+            Emitted emitted;
+            emitted.target = static_cast<uint16_t>(imm);
+            emitted.length = static_cast<uint8_t>(regB(word));
+            emitted.bytes[0] = static_cast<unsigned char>(a);
+            for (unsigned int i = 1; i < emitted.length; i++)
+            {
+                emitted.bytes[i] = static_cast<unsigned char>(std::min(std::max(r[regA(word) + i], 0), 127));
+            }
+            out.push_back(emitted);
+            break;
+        }
+        }
+        pc++;
+    }
+}
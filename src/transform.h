@@ -0,0 +1,78 @@
+#ifndef NODE_MIDI_TRANSFORM_H
+#define NODE_MIDI_TRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A small register machine which runs per-event rules on the input thread,
+// so that events can be filtered, rewritten and sent on to outputs without
+// a trip through JS. Programs are built by lib/transform.js.
+//
+// Each instruction is one 32-bit word: the opcode in the low byte, register
+// a in the next four bits, register b in the four above, and a signed 16-bit
+// immediate in the top half. Jumps are relative and may only go forwards,
+// so a program runs at most once through its instructions per event.
+//
+// On entry r0 holds the status, r1 and r2 the data bytes (0 when absent),
+// r3 the length, r4 the channel (-1 for system messages) and r5 the status
+// with the channel masked off. The other registers start at 0.
+class TransformVm
+{
+public:
+    enum Opcode
+    {
+        End,     // Stop
+        LoadI,   // a = imm
+        Mov,     // a = b
+        Add,     // a += b
+        Sub,     // a -= b
+        Mul,     // a *= b
+        Div,     // a /= b, or 0 when b is 0
+        And,     // a &= b
+        Or,      // a |= b
+        Shl,     // a <<= (b & 31)
+        Shr,     // a >>= (b & 31)
+        Min,     // a = min(a, b)
+        Max,     // a = max(a, b)
+        AddI,    // a += imm
+        Lookup,  // a = table imm at index a, clamped to the table
+        Jump,    // pc += imm
+        JumpEq,  // pc += imm if a == b
+        JumpNe,  // pc += imm if a != b
+        JumpLt,  // pc += imm if a < b
+        JumpGt,  // pc += imm if a > b
+        Forward, // Send the incoming message to target imm
+        Emit,    // Send b bytes from a onwards to target imm
+        OpcodeCount,
+    };
+
+    static const unsigned int Registers = 16;
+
+    // Target 0 is JS, the others index the outputs from 1
+    struct Emitted
+    {
+        uint16_t target;
+        uint8_t length;
+        unsigned char bytes[3];
+    };
+
+    static uint32_t encode(Opcode op, unsigned int a = 0, unsigned int b = 0, int imm = 0);
+
+    // Checks and installs a program, returning false with a reason if it is
+    // malformed. An empty program removes the transform.
+    bool load(std::vector<uint32_t> code, std::vector<std::vector<int32_t>> tables, size_t targets, std::string &error);
+    void clear();
+    bool isLoaded() const { return !code.empty(); }
+
+    // Runs the program over a message of one to three bytes, appending what
+    // it sends. Anything longer, such as sysex, is not for the VM to judge.
+    void run(const unsigned char *message, size_t length, std::vector<Emitted> &out) const;
+
+private:
+    std::vector<uint32_t> code;
+    std::vector<std::vector<int32_t>> tables;
+};
+
+#endif // NODE_MIDI_TRANSFORM_H
@@ -0,0 +1,421 @@
+#include <cstring>
+
+#include "ump.h"
+
+const uint8_t Ump::packetWords[16] = {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+
+namespace
+{
+    // Data bytes following a channel voice status, indexed by the upper nibble minus 8
+    const uint8_t channelDataBytes[7] = {2, 2, 2, 2, 1, 1, 2};
+
+    // Data bytes following a system status, indexed by the lower nibble
+    const uint8_t systemDataBytes[16] = {0, 1, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    template <unsigned int Src, unsigned int Dst>
+    struct ScaleTable
+    {
+        uint32_t values[1u << Src];
+
+        ScaleTable()
+        {
+            for (uint32_t i = 0; i < (1u << Src); i++)
+            {
+                values[i] = Ump::scaleUp(i, Src, Dst);
+            }
+        }
+    };
+
+    const ScaleTable<7, 16> scale7to16;
+    const ScaleTable<7, 32> scale7to32;
+
+    // MIDI 1.0 channel voice to MIDI 2.0 channel voice, filling the opcode,
+    // index and data fields of the two packet words
+    typedef void (*Midi2Translator)(uint8_t d1, uint8_t d2, uint32_t &w0, uint32_t &w1);
+
+    void noteOff(uint8_t note, uint8_t velocity, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0x8u << 20) | (note << 8);
+        w1 = scale7to16.values[velocity] << 16;
+    }
+
+    void noteOn(uint8_t note, uint8_t velocity, uint32_t &w0, uint32_t &w1)
+    {
+        if (velocity == 0)
+        {
+            // Velocity 0 is a note off in MIDI 1.0, but a real note on in MIDI 2.0
+            noteOff(note, 64, w0, w1);
+            return;
+        }
+        w0 |= (0x9u << 20) | (note << 8);
+        w1 = scale7to16.values[velocity] << 16;
+    }
+
+    void polyPressure(uint8_t note, uint8_t pressure, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0xAu << 20) | (note << 8);
+        w1 = scale7to32.values[pressure];
+    }
+
+    void controlChange(uint8_t controller, uint8_t value, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0xBu << 20) | (controller << 8);
+        w1 = scale7to32.values[value];
+    }
+
+    void programChange(uint8_t program, uint8_t, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0xCu << 20);
+        w1 = program << 24;
+    }
+
+    void channelPressure(uint8_t pressure, uint8_t, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0xDu << 20);
+        w1 = scale7to32.values[pressure];
+    }
+
+    void pitchBend(uint8_t lsb, uint8_t msb, uint32_t &w0, uint32_t &w1)
+    {
+        w0 |= (0xEu << 20);
+        w1 = Ump::scaleUp((msb << 7) | lsb, 14, 32);
+    }
+
+    const Midi2Translator midi2Translators[7] = {
+        noteOff,
+        noteOn,
+        polyPressure,
+        controlChange,
+        programChange,
+        channelPressure,
+        pitchBend,
+    };
+
+    void appendMessage(std::vector<unsigned char> &bytes, std::vector<size_t> &lengths, const unsigned char *message, size_t length)
+    {
+        bytes.insert(bytes.end(), message, message + length);
+        lengths.push_back(length);
+    }
+
+    void appendControlChange(std::vector<unsigned char> &bytes, std::vector<size_t> &lengths, uint8_t channel, uint8_t controller, uint8_t value)
+    {
+        const unsigned char message[3] = {(unsigned char)(0xB0 | channel), controller, value};
+        appendMessage(bytes, lengths, message, 3);
+    }
+}
+
+uint32_t Ump::scaleUp(uint32_t value, unsigned int srcBits, unsigned int dstBits)
+{
+    unsigned int scaleBits = dstBits - srcBits;
+    uint64_t shifted = (uint64_t)value << scaleBits;
+    uint32_t center = 1u << (srcBits - 1);
+    if (value <= center)
+    {
+        return (uint32_t)shifted;
+    }
+
+    // Above center, repeat the lower source bits to fill the new resolution
+    // so that the maximum source value maps onto the maximum destination value
+    unsigned int repeatBits = srcBits - 1;
+    uint64_t repeat = value & ((1u << repeatBits) - 1);
+    if (scaleBits > repeatBits)
+    {
+        repeat <<= scaleBits - repeatBits;
+    }
+    else
+    {
+        repeat >>= repeatBits - scaleBits;
+    }
+
+    while (repeat != 0)
+    {
+        shifted |= repeat;
+        repeat >>= repeatBits;
+    }
+
+    return (uint32_t)shifted;
+}
+
+uint32_t Ump::scaleDown(uint32_t value, unsigned int srcBits, unsigned int dstBits)
+{
+    return value >> (srcBits - dstBits);
+}
+
+bool Ump::fromMidi1(const unsigned char *message, size_t length, Protocol protocol, uint8_t group, std::vector<uint32_t> &words)
+{
+    if (length == 0 || message[0] < 0x80)
+    {
+        return false;
+    }
+
+    uint32_t groupBits = (uint32_t)(group & 0x0F) << 24;
+    uint8_t status = message[0];
+
+    if (status == 0xF0)
+    {
+        // Sysex is carried as 7-bit data packets of up to 6 bytes, without the F0/F7 framing
+        const unsigned char *data = message + 1;
+        size_t dataLength = length - 1;
+        if (dataLength > 0 && data[dataLength - 1] == 0xF7)
+        {
+            dataLength--;
+        }
+
+        size_t offset = 0;
+        do
+        {
+            size_t chunk = dataLength - offset < 6 ? dataLength - offset : 6;
+            bool first = offset == 0;
+            bool last = offset + chunk == dataLength;
+            uint32_t packetStatus = first ? (last ? 0x0 : 0x1) : (last ? 0x3 : 0x2);
+
+            uint8_t b[6] = {0, 0, 0, 0, 0, 0};
+            memcpy(b, data + offset, chunk);
+
+            words.push_back((0x3u << 28) | groupBits | (packetStatus << 20) | ((uint32_t)chunk << 16) | (b[0] << 8) | b[1]);
+            words.push_back(((uint32_t)b[2] << 24) | (b[3] << 16) | (b[4] << 8) | b[5]);
+
+            offset += chunk;
+        } while (offset < dataLength);
+
+        return true;
+    }
+
+    if (status >= 0xF0)
+    {
+        if (status == 0xF7)
+        {
+            return false;
+        }
+
+        uint8_t dataBytes = systemDataBytes[status & 0x0F];
+        if (length < 1u + dataBytes)
+        {
+            return false;
+        }
+
+        uint32_t word = (0x1u << 28) | groupBits | ((uint32_t)status << 16);
+        if (dataBytes > 0)
+        {
+            word |= (message[1] & 0x7F) << 8;
+        }
+        if (dataBytes > 1)
+        {
+            word |= message[2] & 0x7F;
+        }
+        words.push_back(word);
+        return true;
+    }
+
+    uint8_t dataBytes = channelDataBytes[(status >> 4) - 8];
+    if (length < 1u + dataBytes)
+    {
+        return false;
+    }
+
+    uint8_t d1 = message[1] & 0x7F;
+    uint8_t d2 = dataBytes > 1 ? message[2] & 0x7F : 0;
+
+    if (protocol == MIDI1)
+    {
+        words.push_back((0x2u << 28) | groupBits | ((uint32_t)status << 16) | (d1 << 8) | d2);
+        return true;
+    }
+
+    uint32_t w0 = (0x4u << 28) | groupBits | ((uint32_t)(status & 0x0F) << 16);
+    uint32_t w1 = 0;
+    midi2Translators[(status >> 4) - 8](d1, d2, w0, w1);
+
+    words.push_back(w0);
+    words.push_back(w1);
+    return true;
+}
+
+size_t Ump::wholePackets(const uint32_t *words, size_t count)
+{
+    size_t offset = 0;
+    while (offset < count)
+    {
+        size_t size = packetWords[words[offset] >> 28];
+        if (offset + size > count)
+        {
+            break;
+        }
+        offset += size;
+    }
+
+    return offset;
+}
+
+size_t UmpDecoder::decode(const uint32_t *words, size_t count, std::vector<unsigned char> &bytes, std::vector<size_t> &lengths)
+{
+    size_t offset = 0;
+    while (offset < count)
+    {
+        size_t size = Ump::packetWords[words[offset] >> 28];
+        if (offset + size > count)
+        {
+            break;
+        }
+
+        decodePacket(words + offset, bytes, lengths);
+        offset += size;
+    }
+
+    return offset;
+}
+
+void UmpDecoder::reset()
+{
+    for (auto &buffer : sysex)
+    {
+        buffer.clear();
+    }
+}
+
+void UmpDecoder::decodePacket(const uint32_t *words, std::vector<unsigned char> &bytes, std::vector<size_t> &lengths)
+{
+    uint32_t w0 = words[0];
+    uint8_t messageType = w0 >> 28;
+
+    switch (messageType)
+    {
+    case 0x1: // System common and realtime
+    {
+        uint8_t status = (w0 >> 16) & 0xFF;
+        if (status <= 0xF0 || status == 0xF7)
+        {
+            return;
+        }
+
+        const unsigned char message[3] = {status, (unsigned char)((w0 >> 8) & 0x7F), (unsigned char)(w0 & 0x7F)};
+        appendMessage(bytes, lengths, message, 1 + systemDataBytes[status & 0x0F]);
+        return;
+    }
+    case 0x2: // MIDI 1.0 channel voice
+    {
+        uint8_t status = (w0 >> 16) & 0xFF;
+        if (status < 0x80 || status >= 0xF0)
+        {
+            return;
+        }
+
+        const unsigned char message[3] = {status, (unsigned char)((w0 >> 8) & 0x7F), (unsigned char)(w0 & 0x7F)};
+        appendMessage(bytes, lengths, message, 1 + channelDataBytes[(status >> 4) - 8]);
+        return;
+    }
+    case 0x3: // 7-bit sysex data
+    {
+        std::vector<unsigned char> &buffer = sysex[(w0 >> 24) & 0x0F];
+        uint8_t packetStatus = (w0 >> 20) & 0x0F;
+        size_t count = (w0 >> 16) & 0x0F;
+        if (count > 6)
+        {
+            count = 6;
+        }
+
+        const unsigned char data[6] = {
+            (unsigned char)((w0 >> 8) & 0x7F),
+            (unsigned char)(w0 & 0x7F),
+            (unsigned char)((words[1] >> 24) & 0x7F),
+            (unsigned char)((words[1] >> 16) & 0x7F),
+            (unsigned char)((words[1] >> 8) & 0x7F),
+            (unsigned char)(words[1] & 0x7F),
+        };
+
+        if (packetStatus == 0x0 || packetStatus == 0x1)
+        {
+            buffer.assign(1, 0xF0);
+        }
+        else if (buffer.empty())
+        {
+            // Continuation without a start packet
+            return;
+        }
+
+        buffer.insert(buffer.end(), data, data + count);
+
+        if (packetStatus == 0x0 || packetStatus == 0x3)
+        {
+            buffer.push_back(0xF7);
+            appendMessage(bytes, lengths, buffer.data(), buffer.size());
+            buffer.clear();
+        }
+        return;
+    }
+    case 0x4: // MIDI 2.0 channel voice
+    {
+        uint32_t w1 = words[1];
+        uint8_t opcode = (w0 >> 20) & 0x0F;
+        uint8_t channel = (w0 >> 16) & 0x0F;
+        uint8_t index = (w0 >> 8) & 0x7F;
+
+        switch (opcode)
+        {
+        case 0x2: // Registered controller
+        case 0x3: // Assignable controller
+        {
+            uint32_t value = Ump::scaleDown(w1, 32, 14);
+            bool registered = opcode == 0x2;
+            appendControlChange(bytes, lengths, channel, registered ? 101 : 99, index);
+            appendControlChange(bytes, lengths, channel, registered ? 100 : 98, w0 & 0x7F);
+            appendControlChange(bytes, lengths, channel, 6, (value >> 7) & 0x7F);
+            appendControlChange(bytes, lengths, channel, 38, value & 0x7F);
+            return;
+        }
+        case 0x8: // Note off
+        case 0x9: // Note on
+        {
+            uint8_t velocity = Ump::scaleDown(w1 >> 16, 16, 7);
+            if (opcode == 0x9 && velocity == 0)
+            {
+                // A MIDI 1.0 note on with velocity 0 would be a note off
+                velocity = 1;
+            }
+
+            const unsigned char message[3] = {(unsigned char)((opcode << 4) | channel), index, velocity};
+            appendMessage(bytes, lengths, message, 3);
+            return;
+        }
+        case 0xA: // Poly pressure
+        case 0xB: // Control change
+        {
+            const unsigned char message[3] = {(unsigned char)((opcode << 4) | channel), index, (unsigned char)Ump::scaleDown(w1, 32, 7)};
+            appendMessage(bytes, lengths, message, 3);
+            return;
+        }
+        case 0xC: // Program change, with optional bank select
+        {
+            if (w0 & 0x01)
+            {
+                appendControlChange(bytes, lengths, channel, 0, (w1 >> 8) & 0x7F);
+                appendControlChange(bytes, lengths, channel, 32, w1 & 0x7F);
+            }
+
+            const unsigned char message[2] = {(unsigned char)(0xC0 | channel), (unsigned char)((w1 >> 24) & 0x7F)};
+            appendMessage(bytes, lengths, message, 2);
+            return;
+        }
+        case 0xD: // Channel pressure
+        {
+            const unsigned char message[2] = {(unsigned char)(0xD0 | channel), (unsigned char)Ump::scaleDown(w1, 32, 7)};
+            appendMessage(bytes, lengths, message, 2);
+            return;
+        }
+        case 0xE: // Pitch bend
+        {
+            uint32_t value = Ump::scaleDown(w1, 32, 14);
+            const unsigned char message[3] = {(unsigned char)(0xE0 | channel), (unsigned char)(value & 0x7F), (unsigned char)((value >> 7) & 0x7F)};
+            appendMessage(bytes, lengths, message, 3);
+            return;
+        }
+        default:
+            // Per-note and relative controllers have no MIDI 1.0 equivalent
+            return;
+        }
+    }
+    default:
+        // Utility, 8-bit data and reserved packets are not translated
+        return;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef NODE_MIDI_UMP_H
+#define NODE_MIDI_UMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Translation between MIDI 1.0 byte streams and MIDI 2.0 Universal MIDI
+// Packets, following the default translation rules of the UMP specification.
+class Ump
+{
+public:
+    enum Protocol
+    {
+        MIDI1 = 1, // channel voice as MIDI 1.0 packets (message type 0x2)
+        MIDI2 = 2, // channel voice as MIDI 2.0 packets (message type 0x4)
+    };
+
+    // Number of 32-bit words in a packet, indexed by message type
+    static const uint8_t packetWords[16];
+
+    // Min-center-max scaling between resolutions
+    static uint32_t scaleUp(uint32_t value, unsigned int srcBits, unsigned int dstBits);
+    static uint32_t scaleDown(uint32_t value, unsigned int srcBits, unsigned int dstBits);
+
+    // Number of leading words that form whole packets
+    static size_t wholePackets(const uint32_t *words, size_t count);
+
+    // Append the packets for one complete MIDI 1.0 message to words.
+    // Returns false if the message has no UMP representation.
+    static bool fromMidi1(const unsigned char *message, size_t length, Protocol protocol, uint8_t group, std::vector<uint32_t> &words);
+};
+
+// Converts a stream of UMP words back into MIDI 1.0 messages. Sysex
+// reassembly is stateful, so a decoder should be kept per destination.
+class UmpDecoder
+{
+public:
+    // Decode count words, appending each complete message to bytes and its
+    // length to lengths. Returns the number of words consumed; a trailing
+    // partial packet is left for the caller to resubmit.
+    size_t decode(const uint32_t *words, size_t count, std::vector<unsigned char> &bytes, std::vector<size_t> &lengths);
+
+    void reset();
+
+private:
+    std::vector<unsigned char> sysex[16];
+
+    void decodePacket(const uint32_t *words, std::vector<unsigned char> &bytes, std::vector<size_t> &lengths);
+};
+
+#endif // NODE_MIDI_UMP_H
@@ -116,6 +116,193 @@ describe('midi.Input', function() {
     });
   });
 
+  describe('.switchPort', function() {
+    it('requires an integer', function() {
+      (function() {
+        input.switchPort('asdf');
+      }).should.throw('First argument must be an integer');
+    });
+
+    it('requires a valid port', function() {
+      (function() {
+        input.switchPort(999);
+      }).should.throw('Invalid MIDI port number');
+    });
+  });
+
+
+  describe('.enableUmp', function() {
+    it('requires integer arguments', function() {
+      (function() {
+        input.enableUmp('asdf');
+      }).should.throw('Arguments must be integers');
+    });
+
+    it('requires a valid protocol', function() {
+      (function() {
+        input.enableUmp(3);
+      }).should.throw('Invalid UMP protocol or group');
+    });
+
+    it('requires a valid group', function() {
+      (function() {
+        input.enableUmp(2, 16);
+      }).should.throw('Invalid UMP protocol or group');
+    });
+
+    it('can be disabled again', function() {
+      input.enableUmp();
+      input.disableUmp();
+    });
+  });
+
+
+  describe('.assembleParameters', function() {
+    it('requires boolean arguments', function() {
+      (function() {
+        input.assembleParameters(1, 2, 3);
+      }).should.throw('Expected three booleans and a timeout');
+    });
+
+    it('requires a non-negative timeout', function() {
+      (function() {
+        input.assembleParameters(true, true, true, -1);
+      }).should.throw('Timeout must not be negative');
+    });
+
+    it('does not throw when enabling all kinds', function() {
+      (function() {
+        input.assembleParameters(true, true, true);
+      }).should.not.throw();
+    });
+  });
+
+
+  describe('.assembleChords', function() {
+    it('requires boolean arguments', function() {
+      (function() {
+        input.assembleChords(1, 2);
+      }).should.throw('Expected two booleans and a window');
+    });
+
+    it('requires a positive window', function() {
+      (function() {
+        input.assembleChords(true, true, 0);
+      }).should.throw('Window must be positive');
+    });
+  });
+
+  describe('.thinControllers', function() {
+    it('requires an array of rules', function() {
+      (function() {
+        input.input.thinControllers({});
+      }).should.throw('First argument must be an array of rules');
+    });
+
+    it('rejects rules out of range', function() {
+      (function() {
+        input.thinControllers([{ channel: 16 }]);
+      }).should.throw('Invalid thinning rule');
+      (function() {
+        input.thinControllers([{ rate: -1 }]);
+      }).should.throw('Invalid thinning rule');
+    });
+
+    it('can be turned off', function() {
+      (function() {
+        input.thinControllers([{ deadband: 2 }]);
+        input.thinControllers();
+      }).should.not.throw();
+    });
+  });
+
+  describe('.publish', function() {
+    it('requires a hub name', function() {
+      (function() {
+        input.publish();
+      }).should.throw('Expected a hub name and a capacity');
+    });
+
+    it('requires a positive capacity', function() {
+      (function() {
+        input.publish('hub', 0);
+      }).should.throw('Capacity must be positive');
+    });
+
+    it('can be turned off', function() {
+      (function() {
+        input.publish('hub');
+        input.unpublish();
+      }).should.not.throw();
+    });
+  });
+
+  describe('.setTransform', function() {
+    it('requires compiled code', function() {
+      (function() {
+        input.setTransform({ code: [0], tables: [], outputs: [] });
+      }).should.throw('Expected a Uint32Array, an array of tables and an array of outputs');
+    });
+
+    it('rejects jumps out of the program', function() {
+      (function() {
+        input.setTransform({ code: new Uint32Array([15 | (2 << 16)]), tables: [], outputs: [] });
+      }).should.throw('Jump out of range at instruction 0');
+    });
+
+    it('requires outputs as targets', function() {
+      (function() {
+        input.setTransform({ code: new Uint32Array([20 | (1 << 16)]), tables: [], outputs: [{}] });
+      }).should.throw('Transform targets must be outputs');
+    });
+
+    it('accepts rules and can be cleared', function() {
+      (function() {
+        input.setTransform([{ match: { type: 'noteon' }, forward: true }]);
+        input.clearTransform();
+      }).should.not.throw();
+    });
+  });
+
+  describe('.startCapture', function() {
+    it('requires a path', function() {
+      (function() {
+        input.startCapture();
+      }).should.throw('First argument must be a string');
+    });
+  });
+
+  describe('.setInputPool', function() {
+    it('requires an integer', function() {
+      (function() {
+        input.setInputPool('asdf');
+      }).should.throw('Arguments must be integers');
+    });
+
+    it('is kept until a port is opened', function() {
+      var pooled = new Midi.Input();
+      pooled.setInputPool(1000, 65536);
+      pooled.setInputAutoGrow(2000);
+      pooled.getStats().inputPool.should.eql(0);
+
+      pooled.openVirtualPort('node-midi pool');
+      // Only ALSA has an input pool
+      pooled.getStats().inputPool.should.eql(process.platform === 'linux' ? 1000 : 0);
+      pooled.closePort();
+    });
+  });
+
+  describe('.getStats', function() {
+    it('starts with empty counters', function() {
+      var stats = input.getStats();
+      stats.messagesIn.should.eql(0);
+      stats.queueDepth.should.eql(0);
+      stats.dropped.should.eql({ closed: 0, conversion: 0, send: 0 });
+      stats.overruns.should.eql(0);
+      stats.thinned.should.eql(0);
+    });
+  });
+
 
   describe(".on('message')", function() {
     it('allows promises to resolve', async function() {
@@ -185,3 +372,79 @@ describe('midi.Input', function() {
     });
   });
 });
+
+describe('midi.ReplayInput', function() {
+  var fs = require('fs');
+  var os = require('os');
+  var path = require('path');
+  var file = path.join(os.tmpdir(), 'node-midi-capture-test-' + process.pid);
+
+  afterEach(()=>{
+    fs.rmSync(file, { force: true });
+  });
+
+  function writeCapture(records) {
+    var header = Buffer.alloc(16);
+    header.write('NMCP', 0, 'latin1');
+    header.writeUInt32LE(1, 4);
+
+    var chunks = [header];
+    records.forEach(function(record) {
+      var head = Buffer.alloc(14);
+      head.writeBigUInt64LE(BigInt(record.time), 0);
+      head.writeUInt16LE(0, 8);
+      head.writeUInt32LE(record.message.length, 10);
+      chunks.push(head, Buffer.from(record.message));
+    });
+    fs.writeFileSync(file, Buffer.concat(chunks));
+  }
+
+  it('rejects a missing capture', function() {
+    var replay = new Midi.ReplayInput(file);
+    (function() {
+      replay.openPort(0);
+    }).should.throw('Failed to read capture file');
+  });
+
+  it('replays a capture as fast as possible', function(done) {
+    writeCapture([
+      { time: 0, message: [0x90, 60, 100] },
+      { time: 5e8, message: [0x80, 60, 0] },
+    ]);
+
+    var replay = new Midi.ReplayInput(file, { realtime: false });
+    var messages = [];
+    replay.on('message', function(deltaTime, message) {
+      messages.push([deltaTime, message]);
+    });
+    replay.on('end', function() {
+      replay.isPortOpen().should.be.false();
+      // No driver client is created just to replay
+      replay.getStats().inputPool.should.eql(0);
+      replay.closePort();
+      messages.should.eql([[0, [0x90, 60, 100]], [0.5, [0x80, 60, 0]]]);
+      done();
+    });
+    replay.openPort(0);
+  });
+
+  it('counts as open until the capture has been delivered', function(done) {
+    writeCapture([
+      { time: 0, message: [0x90, 60, 100] },
+      { time: 2e8, message: [0x80, 60, 0] },
+    ]);
+
+    var replay = new Midi.ReplayInput(file);
+    replay.on('message', function(deltaTime, message) {
+      if (message[0] === 0x90) {
+        replay.isPortOpen().should.be.true();
+      }
+    });
+    replay.on('end', function() {
+      replay.isPortOpen().should.be.false();
+      replay.closePort();
+      done();
+    });
+    replay.openPort(0);
+  });
+});
@@ -0,0 +1,651 @@
+var should = require('should');
+var Midi = require('../../midi');
+
+describe('loopback API', function() {
+  var input, output, others;
+
+  // The loopback registry is shared by the whole process, so every test
+  // closes what it opened and finds ports by the names it gave them
+  beforeEach(()=>{
+    input = new Midi.Input(Midi.Api.LOOPBACK);
+    output = new Midi.Output(Midi.Api.LOOPBACK);
+    others = [];
+  });
+
+  afterEach(()=>{
+    others.forEach((port) => port.closePort());
+    output.closePort();
+    input.closePort();
+    Midi.setLoopbackLatency(0);
+  });
+
+  function portNames(port) {
+    var names = [];
+    for (var i = 0; i < port.getPortCount(); i++) {
+      names.push(port.getPortName(i));
+    }
+    return names;
+  }
+
+  it('lists virtual inputs as outputs', function() {
+    portNames(output).should.not.containEql('node-midi loopback');
+    input.openVirtualPort('node-midi loopback');
+    portNames(output).should.containEql('node-midi loopback');
+  });
+
+  it('lists ports without a port object', function() {
+    Midi.listOutputs(Midi.Api.LOOPBACK).should.not.containEql('node-midi list');
+    input.openVirtualPort('node-midi list');
+    Midi.listOutputs(Midi.Api.LOOPBACK).should.containEql('node-midi list');
+    Midi.listInputs(Midi.Api.LOOPBACK).should.not.containEql('node-midi list');
+    output.openVirtualPort('node-midi list');
+    Midi.listInputs(Midi.Api.LOOPBACK).should.containEql('node-midi list');
+  });
+
+  it('delivers messages from an output to an input', function(done) {
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0x90, 60, 100]);
+      done();
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('ignores every timing message when asked to', function(done) {
+    input.ignoreTypes(true, true, true);
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0x90, 60, 100]);
+      done();
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0xf8]);
+    output.sendMessage([0xf9]);
+    output.sendMessage([0xf1, 0x10]);
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('delivers messages from a virtual output', function(done) {
+    output.openVirtualPort('node-midi loopback');
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0xb0, 7, 64]);
+      done();
+    });
+    input.openPortByName('node-midi loopback');
+    output.sendMessage([0xb0, 7, 64]);
+  });
+
+  it('delivers a split byte stream sent in one call', function(done) {
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (received.length === 3) {
+        received.should.eql([[0x90, 60, 100], [0x90, 62, 100], [0xb0, 7, 64]]);
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessages(Midi.splitMessages([0x90, 60, 100, 62, 100, 0xb0, 7, 64]));
+  });
+
+  it('translates MIDI 2.0 channel voice to MIDI 1.0', function(done) {
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (received.length === 5) {
+        received.should.eql([
+          [0x90, 60, 127],
+          [0x90, 62, 64],
+          [0xb0, 7, 64],
+          [0xe0, 0x7f, 0x7f],
+          [0xe0, 0, 64],
+        ]);
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi ump');
+    output.openPortByName('node-midi ump');
+    output.sendUmp([
+      0x40903c00, 0xffff0000,
+      0x40903e00, 0x80000000,
+      0x40b00700, 0x80000000,
+      0x40e00000, 0xffffffff,
+      0x40e00000, 0x80000000,
+    ]);
+  });
+
+  it('leaves sysex state alone when a packet is incomplete', function(done) {
+    input.ignoreTypes(false, true, true);
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0xf0, 1, 2, 5, 6, 0xf7]);
+      done();
+    });
+    input.openVirtualPort('node-midi ump');
+    output.openPortByName('node-midi ump');
+    output.sendUmp([0x30120102, 0]);
+    (function() {
+      output.sendUmp([0x30220304, 0, 0x40903c00]);
+    }).should.throw('Incomplete UMP packet');
+    output.sendUmp([0x30320506, 0]);
+  });
+
+  it('pairs 14-bit controllers that send an LSB', function(done) {
+    var events = [];
+    function record(type) {
+      input.on(type, function(deltaTime, data) {
+        events.push([type, data]);
+        if (type === 'message' && data[0] === 0x90) {
+          events.should.eql([
+            ['message', [0xb0, 0, 2]],
+            ['message', [0xc0, 5]],
+            ['message', [0xb0, 7, 100]],
+            ['cc14', { channel: 0, param: 7, value: (100 << 7) | 5 }],
+            ['cc14', { channel: 0, param: 7, value: (101 << 7) | 6 }],
+            ['message', [0x90, 60, 100]],
+          ]);
+          done();
+        }
+      });
+    }
+    record('message');
+    record('cc14');
+    input.assembleParameters(true, false, false, 50);
+    input.openVirtualPort('node-midi params');
+    output.openPortByName('node-midi params');
+    // Bank select MSB without an LSB must not be held behind the program change
+    output.sendMessage([0xb0, 0, 2]);
+    output.sendMessage([0xc0, 5]);
+    output.sendMessage([0xb0, 7, 100]);
+    output.sendMessage([0xb0, 39, 5]);
+    output.sendMessage([0xb0, 7, 101]);
+    output.sendMessage([0xb0, 39, 6]);
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('assembles RPN and NRPN data entry', function(done) {
+    var events = [];
+    function record(type) {
+      input.on(type, function(deltaTime, data) {
+        events.push([type, data]);
+        if (type === 'message') {
+          events.should.eql([
+            ['rpn', { channel: 0, param: 0, value: 2 << 7 }],
+            ['nrpn', { channel: 1, param: (1 << 7) | 2, value: (3 << 7) | 4 }],
+            ['nrpn', { channel: 1, param: (1 << 7) | 2, value: (3 << 7) | 5 }],
+            ['message', [0xb0, 6, 9]],
+          ]);
+          done();
+        }
+      });
+    }
+    record('message');
+    record('rpn');
+    record('nrpn');
+    input.assembleParameters(false, true, true, 50);
+    input.openVirtualPort('node-midi params');
+    output.openPortByName('node-midi params');
+    output.sendMessage([0xb0, 101, 0]);
+    output.sendMessage([0xb0, 100, 0]);
+    output.sendMessage([0xb0, 6, 2]);
+    output.sendMessage([0xb0, 38, 0]);
+    output.sendMessage([0xb1, 99, 1]);
+    output.sendMessage([0xb1, 98, 2]);
+    output.sendMessage([0xb1, 6, 3]);
+    output.sendMessage([0xb1, 38, 4]);
+    // A lone LSB fine-tunes the last value
+    output.sendMessage([0xb1, 38, 5]);
+    // After RPN null, data entry is an ordinary controller again
+    output.sendMessage([0xb0, 101, 127]);
+    output.sendMessage([0xb0, 100, 127]);
+    output.sendMessage([0xb0, 6, 9]);
+  });
+
+  describe('sysex requests', function() {
+    var device, host;
+
+    // The device answers on output, and hears requests sent from host
+    beforeEach(()=>{
+      device = new Midi.Input(Midi.Api.LOOPBACK);
+      host = new Midi.Output(Midi.Api.LOOPBACK);
+      device.ignoreTypes(false, true, true);
+      device.openVirtualPort('node-midi sysex device');
+      host.openPortByName('node-midi sysex device');
+
+      input.ignoreTypes(false, true, true);
+      input.openVirtualPort('node-midi sysex host');
+      output.openPortByName('node-midi sysex host');
+    });
+
+    afterEach(()=>{
+      host.closePort();
+      device.closePort();
+    });
+
+    it('settles each request with the reply matching its pattern', function() {
+      var unmatched = [];
+      input.on('message', function(deltaTime, message) {
+        unmatched.push(message);
+      });
+
+      var requests = 0;
+      device.on('message', function() {
+        if (++requests < 2) {
+          return;
+        }
+        // Answer out of order, after a reply nobody asked for
+        output.sendMessage([0xf0, 0x41, 0x10, 0xf7]);
+        output.sendMessage([0xf0, 0x43, 0x00, 0x02, 0x22, 0xf7]);
+        output.sendMessage([0xf0, 0x43, 0x00, 0x01, 0x11, 0xf7]);
+      });
+
+      return Promise.all([
+        host.request([0xf0, 0x43, 0x20, 0x01, 0xf7], { input, match: [0xf0, 0x43, null, 0x01] }),
+        host.request([0xf0, 0x43, 0x20, 0x02, 0xf7], { input, match: [0xf0, 0x43, null, 0x02] }),
+      ]).then(function(replies) {
+        Array.from(replies[0]).should.eql([0xf0, 0x43, 0x00, 0x01, 0x11, 0xf7]);
+        Array.from(replies[1]).should.eql([0xf0, 0x43, 0x00, 0x02, 0x22, 0xf7]);
+        unmatched.should.eql([[0xf0, 0x41, 0x10, 0xf7]]);
+      });
+    });
+
+    it('resends after WAIT and NAK, and resolves with the ACK', function() {
+      var unmatched = [];
+      input.on('message', function(deltaTime, message) {
+        unmatched.push(message);
+      });
+
+      var received = 0;
+      device.on('message', function(deltaTime, message) {
+        message.should.eql([0xf0, 0x7e, 0x01, 0x01, 0x00, 0xf7]);
+        if (++received === 1) {
+          output.sendMessage([0xf0, 0x7e, 0x01, 0x7c, 0x00, 0xf7]);
+          setTimeout(function() {
+            output.sendMessage([0xf0, 0x7e, 0x01, 0x7e, 0x00, 0xf7]);
+          }, 20);
+        } else {
+          output.sendMessage([0xf0, 0x7e, 0x01, 0x7f, 0x00, 0xf7]);
+        }
+      });
+
+      return host.request([0xf0, 0x7e, 0x01, 0x01, 0x00, 0xf7], { input, handshake: true, retries: 1 }).then(function(reply) {
+        Array.from(reply).should.eql([0xf0, 0x7e, 0x01, 0x7f, 0x00, 0xf7]);
+        received.should.eql(2);
+        unmatched.should.eql([]);
+      });
+    });
+
+    it('rejects a NAK once the retries are used up', function() {
+      device.on('message', function() {
+        output.sendMessage([0xf0, 0x7e, 0x01, 0x7e, 0x00, 0xf7]);
+      });
+
+      return host.request([0xf0, 0x7e, 0x01, 0x01, 0x00, 0xf7], { input, handshake: true }).should.be.rejectedWith('Request rejected by device');
+    });
+
+    it('times out a device that sends WAIT and goes quiet', function() {
+      device.on('message', function() {
+        output.sendMessage([0xf0, 0x7e, 0x01, 0x7c, 0x00, 0xf7]);
+      });
+
+      var sent = Date.now();
+      return host.request([0xf0, 0x7e, 0x01, 0x01, 0x00, 0xf7], { input, handshake: true, timeoutMs: 2000, waitMs: 50 }).then(function() {
+        throw new Error('Expected the request to time out');
+      }, function(e) {
+        e.message.should.eql('Request timed out');
+        (Date.now() - sent).should.be.below(1000);
+      });
+    });
+  });
+
+  it('switches to another port without reopening', function(done) {
+    var other = new Midi.Output(Midi.Api.LOOPBACK);
+    others.push(other);
+    output.openVirtualPort('node-midi loopback a');
+    other.openVirtualPort('node-midi loopback b');
+
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0x90, 62, 100]);
+      done();
+    });
+    input.openPortByName('node-midi loopback a');
+    input.switchPort(portNames(input).indexOf('node-midi loopback b'));
+    input.isPortOpen().should.be.true();
+    output.sendMessage([0x90, 61, 100]);
+    other.sendMessage([0x90, 62, 100]);
+  });
+
+  it('groups the notes of a chord into one event', function(done) {
+    var events = [];
+    input.on('chord', function(deltaTime, chord) {
+      events.push(['chord', chord]);
+    });
+    input.on('message', function(deltaTime, message) {
+      events.push(['message', message]);
+      if (message[0] !== 0xb0) {
+        return;
+      }
+      events.should.eql([
+        ['chord', { channel: 0, on: true, notes: [60, 64, 67], velocities: [100, 90, 80] }],
+        ['message', [0xb0, 64, 127]],
+      ]);
+      done();
+    });
+    input.assembleChords(true, false, 50);
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+    output.sendMessage([0x90, 64, 90]);
+    output.sendMessage([0x90, 67, 80]);
+    output.sendMessage([0xb0, 64, 127]);
+  });
+
+  it('lets clock through a chord without ending it', function(done) {
+    var events = [];
+    input.on('chord', function(deltaTime, chord) {
+      events.push(['chord', chord]);
+    });
+    input.on('message', function(deltaTime, message) {
+      events.push(['message', message]);
+      if (message[0] !== 0xb0) {
+        return;
+      }
+      events.should.eql([
+        ['message', [0xf8]],
+        ['chord', { channel: 0, on: true, notes: [60, 64, 67], velocities: [100, 90, 80] }],
+        ['message', [0xb0, 64, 127]],
+      ]);
+      done();
+    });
+    input.ignoreTypes(true, false, true);
+    input.assembleChords(true, false, 50);
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+    output.sendMessage([0xf8]);
+    output.sendMessage([0x90, 64, 90]);
+    output.sendMessage([0x90, 67, 80]);
+    output.sendMessage([0xb0, 64, 127]);
+  });
+
+  it('thins controller changes and sends the last one held back', function(done) {
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message[2]);
+      if (message[2] === 80) {
+        received.should.eql([64, 70, 80]);
+        input.getStats().thinned.should.eql(3);
+        done();
+      }
+    });
+    input.thinControllers([{ deadband: 2, rate: 20 }]);
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0xb0, 1, 64]);
+    output.sendMessage([0xb0, 1, 65]);
+    setTimeout(function() {
+      output.sendMessage([0xb0, 1, 70]);
+      output.sendMessage([0xb0, 1, 75]);
+      output.sendMessage([0xb0, 1, 80]);
+    }, 60);
+  });
+
+  it('leaves parameter and mode controllers out of rules for every CC', function(done) {
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (message[0] === 0x90) {
+        received.should.eql([
+          [0xb0, 1, 64],
+          [0xb0, 0, 1],
+          [0xb0, 32, 2],
+          [0xb0, 101, 0],
+          [0xb0, 100, 1],
+          [0xb0, 6, 64],
+          [0xb0, 6, 65],
+          [0xb0, 123, 0],
+          [0xb0, 123, 0],
+          [0x90, 60, 100],
+        ]);
+        input.getStats().thinned.should.eql(1);
+        done();
+      }
+    });
+    input.thinControllers([{ deadband: 2 }]);
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0xb0, 1, 64]);
+    output.sendMessage([0xb0, 1, 65]);
+    output.sendMessage([0xb0, 0, 1]);
+    output.sendMessage([0xb0, 32, 2]);
+    output.sendMessage([0xb0, 101, 0]);
+    output.sendMessage([0xb0, 100, 1]);
+    output.sendMessage([0xb0, 6, 64]);
+    output.sendMessage([0xb0, 6, 65]);
+    output.sendMessage([0xb0, 123, 0]);
+    output.sendMessage([0xb0, 123, 0]);
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('coalesces controller updates on output', function(done) {
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (message[0] === 0x80) {
+        received.should.eql([
+          [0xb0, 7, 30],
+          [0xe0, 0, 64],
+          [0x90, 60, 100],
+          [0xb0, 7, 50],
+          [0x80, 60, 0],
+        ]);
+        output.getStats().coalesced.should.eql(3);
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.coalesceControllers(Infinity);
+    output.sendMessage([0xb0, 7, 10]);
+    output.sendMessage([0xe0, 0, 64]);
+    output.sendMessage([0xb0, 7, 20]);
+    output.sendMessage([0xb0, 7, 30]);
+    output.sendMessage([0x90, 60, 100]);
+    output.sendMessage([0xb0, 7, 40]);
+    output.sendMessage([0xb0, 7, 50]);
+    output.flush();
+    output.sendMessage([0x80, 60, 0]);
+  });
+
+  it('sends the latest controller value once the window is up', function(done) {
+    var received = [];
+    var sent;
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (received.length === 1) {
+        (Date.now() - sent).should.be.above(40);
+        // Nothing else follows it
+        setTimeout(function() {
+          received.should.eql([[0xb0, 7, 30]]);
+          output.getStats().coalesced.should.eql(2);
+          done();
+        }, 100);
+      }
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.coalesceControllers(50);
+    sent = Date.now();
+    output.sendMessage([0xb0, 7, 10]);
+    output.sendMessage([0xb0, 7, 20]);
+    output.sendMessage([0xb0, 7, 30]);
+  });
+
+  it('sends clock ahead of queued sysex', function(done) {
+    var sysex = [0xf0];
+    for (var i = 0; i < 62; i++) {
+      sysex.push(i);
+    }
+    sysex.push(0xf7);
+
+    var received = [];
+    input.ignoreTypes(false, false, true);
+    input.on('message', function(deltaTime, message) {
+      received.push(message[0]);
+      if (received.length === 4) {
+        // The first sysex may already be out, but the second is paced behind it
+        received[3].should.eql(0xf0);
+        received.indexOf(0xf8).should.be.below(received.indexOf(0x90));
+        output.getStats().queuedBytes.should.eql(0);
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.setPriorityLanes(true, { rate: 3125 });
+    output.sendMessage(sysex);
+    output.sendMessage(sysex);
+    output.sendMessage([0xf8]);
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  describe('sysex segments', function() {
+    var sysex = [0xf0];
+    for (var i = 0; i < 62; i++) {
+      sysex.push(i);
+    }
+    sysex.push(0xf7);
+
+    beforeEach(()=>{
+      input.ignoreTypes(false, false, true);
+      input.openVirtualPort('node-midi loopback');
+      output.openPortByName('node-midi loopback');
+      // Four segments, 50ms apart
+      output.setPriorityLanes(true, { rate: 320, chunkSize: 16 });
+    });
+
+    it('sends real time between segments and holds the rest for the end', function(done) {
+      var received = [];
+      input.on('message', function(deltaTime, message) {
+        received.push(message);
+        if (received.length === 3) {
+          received.should.eql([[0xf8], sysex, [0x90, 60, 100]]);
+          done();
+        }
+      });
+      output.sendMessage(sysex);
+      setTimeout(function() {
+        output.sendMessage([0xf8]);
+        output.sendMessage([0x90, 60, 100]);
+      }, 20);
+    });
+
+    it('ends a sysex cut off by closing the port', function(done) {
+      input.on('message', function(deltaTime, message) {
+        message.should.eql(sysex.slice(0, 16).concat([0xf7]));
+        done();
+      });
+      output.sendMessage(sysex);
+      setTimeout(function() {
+        output.closePort();
+      }, 20);
+    });
+
+    it('abandons a sysex interrupted by anything but real time', function(done) {
+      var received = [];
+      input.on('message', function(deltaTime, message) {
+        received.push(message);
+      });
+      // Not held back by the lanes, so it cuts into the sysex
+      var other = new Midi.Output(Midi.Api.LOOPBACK);
+      others.push(other);
+      other.openPortByName('node-midi loopback');
+      output.sendMessage(sysex);
+      setTimeout(function() {
+        other.sendMessage([0x90, 60, 100]);
+      }, 20);
+      setTimeout(function() {
+        received.should.eql([[0x90, 60, 100]]);
+        done();
+      }, 250);
+    });
+  });
+
+  it('fans published messages out to every subscriber', function(done) {
+    var first = new Midi.Subscriber('loopback hub');
+    var second = new Midi.Subscriber('loopback hub');
+    var received = [];
+    function receive(deltaTime, message) {
+      received.push(message);
+      if (received.length === 2) {
+        received.should.eql([[0x90, 60, 100], [0x90, 60, 100]]);
+        first.close();
+        second.close();
+        done();
+      }
+    }
+    first.on('message', receive);
+    second.on('message', receive);
+    input.publish('loopback hub');
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('runs transform rules before messages reach JS', function(done) {
+    input.setTransform([
+      { match: { type: 'noteon', note: [0, 60] } },
+      { match: { type: 'noteon' }, send: { type: 'cc', controller: 20, value: { from: 'velocity', scale: [0, 127, 0, 64] } } },
+    ]);
+
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0xb0, 20, 64]);
+      input.getStats().tsfnCalls.should.eql(1);
+      done();
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+    output.sendMessage([0xb0, 7, 64]);
+    output.sendMessage([0x90, 61, 127]);
+  });
+
+  it('counts the messages on each port and in the process', function(done) {
+    var before = Midi.getStats().messagesOut;
+
+    var received = 0;
+    input.on('message', function() {
+      if (++received < 3) {
+        return;
+      }
+      var stats = input.getStats();
+      stats.messagesIn.should.eql(3);
+      stats.bytesIn.should.eql(9);
+      stats.tsfnCalls.should.eql(3);
+      output.getStats().messagesOut.should.eql(3);
+      output.getStats().writes.should.eql(3);
+      (Midi.getStats().messagesOut - before).should.eql(3);
+      done();
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    output.sendMessage([0x90, 60, 100]);
+    output.sendMessage([0x90, 62, 100]);
+    output.sendMessage([0x90, 64, 100]);
+  });
+
+  it('delays messages by the simulated latency', function(done) {
+    Midi.setLoopbackLatency(50);
+
+    var sent;
+    input.on('message', function() {
+      (Date.now() - sent).should.be.aboveOrEqual(45);
+      done();
+    });
+    input.openVirtualPort('node-midi loopback');
+    output.openPortByName('node-midi loopback');
+    sent = Date.now();
+    output.sendMessage([0x90, 60, 100]);
+  });
+});
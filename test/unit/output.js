@@ -109,5 +109,158 @@ describe('midi.Output', function() {
         output.sendMessage();
       }).should.throw('First argument must be an array or Buffer');
     });
+
+    it('should drop the message when the port was never opened', function() {
+      var unopened = new Midi.Output();
+      unopened.sendMessage([0x90, 60, 100]);
+      unopened.getStats().dropped.send.should.eql(1);
+    });
+  });
+
+  describe('.sendUmp', function() {
+    var output = new Midi.Output();
+
+    it('should require an array argument', function() {
+      (function() {
+        output.sendUmp();
+      }).should.throw('First argument must be an array or Uint32Array');
+    });
+
+    it('should reject a partial packet', function() {
+      (function() {
+        output.sendUmp([0x40903c00]);
+      }).should.throw('Incomplete UMP packet');
+    });
+  });
+
+  describe('.sendMessages', function() {
+    var output = new Midi.Output();
+
+    it('should require a buffer and two Uint32Arrays', function() {
+      (function() {
+        output.sendMessages(Buffer.from([0x90, 60, 100]), [0], [3]);
+      }).should.throw('Expected a buffer and two Uint32Arrays');
+    });
+
+    it('should reject a message outside the buffer', function() {
+      (function() {
+        output.sendMessages(Buffer.from([0x90, 60, 100]), new Uint32Array([1]), new Uint32Array([3]));
+      }).should.throw('Invalid message offset or length');
+    });
+  });
+
+  describe('.request', function() {
+    var output = new Midi.Output();
+
+    it('should require an array argument', function() {
+      return output.request().should.be.rejectedWith('First argument must be an array or Buffer');
+    });
+
+    it('should require an input', function() {
+      return output.request([0xf0, 0x43, 0x20, 0xf7], {}).should.be.rejectedWith('options.input must be an Input');
+    });
+
+    it('should require a complete sysex message', function() {
+      var input = new Midi.Input();
+      return output.request([0xf0, 0x43], { input }).should.be.rejectedWith('Request must be a complete sysex message');
+    });
+
+    it('should require an open input', function() {
+      var input = new Midi.Input();
+      return output.request([0xf0, 0x43, 0x20, 0xf7], { input }).should.be.rejectedWith('Input port is not open');
+    });
+  });
+
+  describe('.setOutputPool', function() {
+    it('requires integer arguments', function() {
+      (function() {
+        output.setOutputPool('big');
+      }).should.throw('Arguments must be integers');
+    });
+
+    it('requires a drain timeout that is not negative', function() {
+      (function() {
+        output.setOutputPool(0, 0, -1);
+      }).should.throw('Drain timeout is out of range');
+    });
+
+    it('accepts a drain timeout', function() {
+      (function() {
+        output.setOutputPool(0, 0, 50);
+      }).should.not.throw();
+    });
+  });
+
+  describe('.coalesceControllers', function() {
+    it('requires a number', function() {
+      (function() {
+        output.coalesceControllers('fast');
+      }).should.throw('First argument must be a number');
+    });
+
+    it('requires a window that is not negative', function() {
+      (function() {
+        output.coalesceControllers(-1);
+      }).should.throw('Window must not be negative');
+    });
+  });
+
+  describe('.setPriorityLanes', function() {
+    it('requires a boolean', function() {
+      (function() {
+        output.setPriorityLanes('yes');
+      }).should.throw('Expected a boolean, a rate and a chunk size');
+    });
+
+    it('requires a chunk size of at least 2', function() {
+      (function() {
+        output.setPriorityLanes(true, { chunkSize: 1 });
+      }).should.throw('Invalid rate or chunk size');
+    });
+  });
+
+  describe('.getStats', function() {
+    it('counts encode errors', function() {
+      (function() {
+        output.sendUmp([0x40903c00]);
+      }).should.throw('Incomplete UMP packet');
+      output.getStats().encodeErrors.should.eql(1);
+    });
+
+    it('includes the output queue counters', function() {
+      output.getStats().should.have.properties({ stalls: 0, retries: 0, pending: 0 });
+    });
+  });
+
+  describe('.nrpn', function() {
+    var output = new Midi.Output();
+
+    it('requires integer arguments', function() {
+      (function() {
+        output.nrpn(0, 'asdf', 1);
+      }).should.throw('Arguments must be integers');
+    });
+
+    it('requires a valid channel', function() {
+      (function() {
+        output.nrpn(16, 1, 1);
+      }).should.throw('Invalid channel, parameter or value');
+    });
+
+    it('requires a 14-bit value', function() {
+      (function() {
+        output.nrpn(0, 1, 16384);
+      }).should.throw('Invalid channel, parameter or value');
+    });
+  });
+
+  describe('.cc14', function() {
+    var output = new Midi.Output();
+
+    it('requires an MSB controller number', function() {
+      (function() {
+        output.cc14(0, 32, 1);
+      }).should.throw('Invalid channel, parameter or value');
+    });
   });
 });
@@ -0,0 +1,108 @@
+var should = require('should');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var Midi = require('../../midi');
+
+describe('midi.FlightRecorder', function() {
+  var file = path.join(os.tmpdir(), 'node-midi-recorder-test-' + process.pid);
+
+  afterEach(()=>{
+    Midi.FlightRecorder.stop();
+    fs.rmSync(file, { force: true });
+  });
+
+  describe('.start', function() {
+    it('requires a path', function() {
+      (function() {
+        Midi.FlightRecorder.start(1);
+      }).should.throw('Expected a path and a size');
+    });
+
+    it('creates an empty recording', function() {
+      Midi.FlightRecorder.start(file, 4096);
+      Midi.FlightRecorder.stop();
+
+      var recording = Midi.FlightRecorder.read(file);
+      recording.events.should.eql([]);
+    });
+  });
+
+  describe('.read', function() {
+    var input, output;
+
+    beforeEach(()=>{
+      input = new Midi.Input(Midi.Api.LOOPBACK);
+      output = new Midi.Output(Midi.Api.LOOPBACK);
+      input.openVirtualPort('node-midi recorder');
+    });
+
+    afterEach(()=>{
+      output.closePort();
+      input.closePort();
+    });
+
+    function sent(recording) {
+      return recording.events.filter((event) => event.direction === 'out').map((event) => event.message);
+    }
+
+    it('reads back what was recorded across a restart', function() {
+      Midi.FlightRecorder.start(file, 4096);
+      output.openPortByName('node-midi recorder');
+      output.sendMessage([0x90, 60, 100]);
+      Midi.FlightRecorder.stop();
+
+      // Reopening carries on from the records already in the file
+      Midi.FlightRecorder.start(file, 4096);
+      output.sendMessage([0x80, 60, 0]);
+      Midi.FlightRecorder.stop();
+
+      var recording = Midi.FlightRecorder.read(file);
+      sent(recording).should.eql([[0x90, 60, 100], [0x80, 60, 0]]);
+      var port = recording.events.find((event) => event.direction === 'out').port;
+      recording.ports[port].should.eql({ name: 'node-midi recorder', direction: 'out' });
+    });
+
+    it('keeps the newest records once the ring wraps', function() {
+      Midi.FlightRecorder.start(file, 4096);
+      output.openPortByName('node-midi recorder');
+      for (var i = 0; i < 300; i++) {
+        output.sendMessage([0xb0, 1, i & 0x7f]);
+      }
+      Midi.FlightRecorder.stop();
+
+      var values = sent(Midi.FlightRecorder.read(file)).map((message) => message[2]);
+      // Records of the input receiving them share the ring
+      values.length.should.be.above(50).and.below(300);
+      values[values.length - 1].should.eql(299 & 0x7f);
+      values.forEach((value, index) => {
+        value.should.eql((300 - values.length + index) & 0x7f);
+      });
+    });
+
+    it('rejects other files', function() {
+      fs.writeFileSync(file, Buffer.alloc(128));
+      (function() {
+        Midi.FlightRecorder.read(file);
+      }).should.throw('Not a flight recorder file');
+    });
+  });
+
+  describe('.toSmf', function() {
+    it('writes a track per port and direction', function() {
+      var smf = Midi.FlightRecorder.toSmf({
+        ports: { 0: { name: 'synth', direction: 'out' } },
+        events: [
+          { time: 1000, port: 0, direction: 'out', message: [0x90, 60, 100] },
+          { time: 1500, port: 0, direction: 'out', message: [0x80, 60, 0] },
+          { time: 1500, port: 1, direction: 'in', message: [0xf8] },
+          { time: 1600, port: 1, direction: 'in', message: [0xf0, 0x43, 0xf7] },
+        ],
+      });
+
+      smf.toString('latin1', 0, 4).should.eql('MThd');
+      // Conductor track, then port 0 out and port 1 in
+      smf.readUInt16BE(10).should.eql(3);
+    });
+  });
+});
@@ -0,0 +1,93 @@
+var should = require('should');
+var Midi = require('../../midi');
+
+(process.platform === 'win32' ? describe.skip : describe)('rtp API', function() {
+  var input, output;
+
+  before(()=>{
+    Midi.setRtpPort(15004);
+    Midi.addRtpPeer('node-midi rtp', '127.0.0.1', 15004);
+  });
+
+  after(()=>{
+    Midi.setRtpPacketLoss(0);
+    Midi.removeRtpPeer('node-midi rtp');
+  });
+
+  beforeEach(()=>{
+    input = new Midi.Input(Midi.Api.RTP);
+    output = new Midi.Output(Midi.Api.RTP);
+  });
+
+  afterEach(()=>{
+    output.closePort();
+    input.closePort();
+  });
+
+  it('lists peers as ports', function() {
+    output.getPortCount().should.eql(1);
+    output.getPortName(0).should.eql('node-midi rtp');
+  });
+
+  it('delivers messages over a session', function(done) {
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0x90, 60, 100]);
+      done();
+    });
+    input.openVirtualPort('node-midi rtp');
+    output.openPortByName('node-midi rtp');
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('delivers sysex split across packets', function(done) {
+    var sysex = [0xf0];
+    for (var i = 0; i < 3000; i++) {
+      sysex.push(i & 0x7f);
+    }
+    sysex.push(0xf7);
+
+    input.ignoreTypes(false, true, true);
+    input.on('message', function(deltaTime, message) {
+      message.should.eql(sysex);
+      done();
+    });
+    input.openVirtualPort('node-midi rtp');
+    output.openPortByName('node-midi rtp');
+    output.sendMessage(sysex);
+  });
+
+  it('recovers controller values from lost packets', function(done) {
+    var values = {};
+    input.on('message', function(deltaTime, message) {
+      if (message[0] === 0xb0) {
+        values[message[1]] = message[2];
+      }
+      if (message[0] === 0x91) {
+        values.should.eql({ 7: 99, 10: 64 });
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi rtp');
+    output.openPortByName('node-midi rtp');
+
+    // Let the session start before dropping anything
+    output.sendMessage([0xb0, 10, 0]);
+    setTimeout(function() {
+      Midi.setRtpPacketLoss(0.5);
+      var sent = 0;
+      var timer = setInterval(function() {
+        output.sendMessage([0xb0, 7, sent % 128]);
+        output.sendMessage([0xb0, 10, 64]);
+        if (++sent < 100) {
+          return;
+        }
+        clearInterval(timer);
+        output.sendMessage([0xb0, 7, 99]);
+        setTimeout(function() {
+          Midi.setRtpPacketLoss(0);
+          output.sendMessage([0x91, 64, 1]);
+        }, 20);
+      }, 2);
+    }, 200);
+  });
+});
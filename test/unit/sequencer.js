@@ -0,0 +1,169 @@
+var should = require('should');
+var Midi = require('../../midi');
+
+describe('midi.Sequencer', function() {
+  var output, sequencer;
+
+  beforeEach(function() {
+    output = new Midi.Output(Midi.Api.LOOPBACK);
+    sequencer = new Midi.Sequencer(output);
+  });
+
+  afterEach(function() {
+    sequencer.stop();
+    sequencer.unfollow();
+    output.closePort();
+  });
+
+  it('requires an output', function() {
+    (function() {
+      new Midi.Sequencer({});
+    }).should.throw('First argument must be an output');
+  });
+
+  describe('.set', function() {
+    it('rejects values out of range', function() {
+      (function() {
+        sequencer.set({ tempo: 0 });
+      }).should.throw('tempo is out of range');
+      (function() {
+        sequencer.set({ swing: 0.9 });
+      }).should.throw('swing is out of range');
+      (function() {
+        sequencer.set({ steps: [{ note: 128 }] });
+      }).should.throw('note is out of range');
+    });
+
+    it('rejects unknown modes', function() {
+      (function() {
+        sequencer.set({ mode: 'sideways' });
+      }).should.throw('Unknown mode');
+    });
+
+    it('keeps the pattern when a change is rejected', function() {
+      sequencer.set({ tempo: 90 });
+      (function() {
+        sequencer.set({ tempo: 2000 });
+      }).should.throw();
+      sequencer.pattern.tempo.should.eql(90);
+    });
+  });
+
+  describe('.follow', function() {
+    it('requires an input', function() {
+      (function() {
+        sequencer.follow(output);
+      }).should.throw('First argument must be an input');
+    });
+  });
+
+  it('plays steps through the output', function(done) {
+    var input = new Midi.Input(Midi.Api.LOOPBACK);
+    var received = [];
+    input.on('message', function(deltaTime, message) {
+      received.push(message);
+      if (received.length === 4) {
+        received.should.eql([[0x91, 40, 90], [0x81, 40, 0], [0x91, 42, 90], [0x81, 42, 0]]);
+        sequencer.isRunning().should.be.true();
+        input.closePort();
+        done();
+      }
+    });
+    input.openVirtualPort('node-midi sequencer');
+    output.openPortByName('node-midi sequencer');
+
+    sequencer.set({ tempo: 600, channel: 1, steps: [{ note: 40, velocity: 90 }, { note: 42, velocity: 90 }] });
+    sequencer.start();
+  });
+
+  describe('playing', function() {
+    var input;
+
+    beforeEach(function() {
+      input = new Midi.Input(Midi.Api.LOOPBACK);
+      input.openVirtualPort('node-midi sequencer');
+      output.openPortByName('node-midi sequencer');
+    });
+
+    afterEach(function() {
+      input.closePort();
+    });
+
+    // Stops the sequencer once count note ons have arrived
+    function noteOns(count, callback) {
+      var notes = [];
+      var times = [];
+      input.on('message', function listener(deltaTime, message) {
+        if ((message[0] & 0xf0) !== 0x90 || message[2] === 0) {
+          return;
+        }
+        notes.push(message[1]);
+        times.push(Number(process.hrtime.bigint()) / 1e6);
+        if (notes.length === count) {
+          input.removeListener('message', listener);
+          sequencer.stop();
+          callback(notes, times);
+        }
+      });
+    }
+
+    it('repeats the same steps for the same seed', function(done) {
+      var steps = [];
+      for (var i = 0; i < 16; i++) {
+        steps.push({ note: 40 + i, probability: 0.5 });
+      }
+      sequencer.set({ tempo: 300, steps: steps, seed: 1234 });
+
+      noteOns(6, function(first) {
+        sequencer.set({ seed: 1234 });
+        noteOns(6, function(second) {
+          second.should.eql(first);
+          done();
+        });
+        sequencer.start();
+      });
+      sequencer.start();
+    });
+
+    it('delays every second step by the swing', function(done) {
+      // 125ms steps, with the odd ones 62.5ms late
+      sequencer.set({ tempo: 120, swing: 0.5, gate: 0.1, steps: [{ note: 40 }, { note: 41 }, { note: 42 }] });
+
+      noteOns(3, function(notes, times) {
+        notes.should.eql([40, 41, 42]);
+        (times[1] - times[0]).should.be.approximately(187.5, 30);
+        (times[2] - times[1]).should.be.approximately(62.5, 30);
+        done();
+      });
+      sequencer.start();
+    });
+
+    it('arpeggiates the held notes in order', function(done) {
+      var keys = new Midi.Input(Midi.Api.LOOPBACK);
+      var player = new Midi.Output(Midi.Api.LOOPBACK);
+      keys.openVirtualPort('node-midi keys');
+      player.openPortByName('node-midi keys');
+      sequencer.follow(keys);
+      sequencer.set({ tempo: 600, mode: 'up', steps: [] });
+
+      var arrived = 0;
+      keys.on('message', function() {
+        if (++arrived === 4) {
+          noteOns(4, function(notes) {
+            // The note off on another channel leaves 60 held
+            notes.should.eql([60, 64, 67, 60]);
+            player.closePort();
+            keys.closePort();
+            done();
+          });
+          sequencer.start();
+        }
+      });
+
+      player.send([0x90, 64, 100]);
+      player.send([0x90, 60, 100]);
+      player.send([0x90, 67, 100]);
+      player.send([0x81, 60, 0]);
+    });
+  });
+});
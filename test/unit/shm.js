@@ -0,0 +1,73 @@
+var should = require('should');
+var fs = require('fs');
+var Midi = require('../../midi');
+
+(process.platform === 'win32' ? describe.skip : describe)('shm API', function() {
+  var input, output;
+
+  before(()=>{
+    Midi.setBusName('node-midi-test');
+  });
+
+  beforeEach(()=>{
+    input = new Midi.Input(Midi.Api.SHM);
+    output = new Midi.Output(Midi.Api.SHM);
+  });
+
+  afterEach(()=>{
+    output.closePort();
+    input.closePort();
+  });
+
+  // Other processes may have ports on the same bus
+  function portNames(port) {
+    var names = [];
+    for (var i = 0; i < port.getPortCount(); i++) {
+      names.push(port.getPortName(i));
+    }
+    return names;
+  }
+
+  it('lists virtual inputs as outputs', function() {
+    input.openVirtualPort('node-midi shm');
+    portNames(output).should.containEql('node-midi shm');
+  });
+
+  it('frees ports when they are closed', function() {
+    input.openVirtualPort('node-midi shm');
+    input.closePort();
+    portNames(output).should.not.containEql('node-midi shm');
+  });
+
+  (process.platform === 'linux' ? it : it.skip)('removes the bus once its last port closes', function() {
+    input.openVirtualPort('node-midi shm');
+    fs.existsSync('/dev/shm/node-midi-test').should.be.true();
+    input.closePort();
+    fs.existsSync('/dev/shm/node-midi-test').should.be.false();
+
+    // The next port goes on a new bus
+    input.openVirtualPort('node-midi shm');
+    portNames(output).should.containEql('node-midi shm');
+  });
+
+  it('delivers messages from an output to an input', function(done) {
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0x90, 60, 100]);
+      done();
+    });
+    input.openVirtualPort('node-midi shm');
+    output.openPortByName('node-midi shm');
+    output.sendMessage([0x90, 60, 100]);
+  });
+
+  it('delivers sysex from a virtual output', function(done) {
+    output.openVirtualPort('node-midi shm');
+    input.ignoreTypes(false, true, true);
+    input.on('message', function(deltaTime, message) {
+      message.should.eql([0xf0, 0x7e, 0x7f, 0x06, 0x01, 0xf7]);
+      done();
+    });
+    input.openPortByName('node-midi shm');
+    output.sendMessage([0xf0, 0x7e, 0x7f, 0x06, 0x01, 0xf7]);
+  });
+});
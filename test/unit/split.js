@@ -0,0 +1,43 @@
+var should = require('should');
+var Midi = require('../../midi');
+
+describe('midi.splitMessages', function() {
+  function messages(split) {
+    return Array.from(split.offsets, function(offset, i) {
+      return Array.from(split.data.subarray(offset, offset + split.lengths[i]));
+    });
+  }
+
+  it('requires a buffer', function() {
+    (function() {
+      Midi.splitMessages('asdf');
+    }).should.throw('First argument must be a buffer');
+  });
+
+  it('expands running status and pulls out realtime bytes', function() {
+    var split = Midi.splitMessages([0x90, 60, 100, 61, 0xf8, 101, 0xc0, 5, 6]);
+    messages(split).should.eql([[0xf8], [0x90, 60, 100], [0x90, 61, 101], [0xc0, 5], [0xc0, 6]]);
+    split.dropped.should.eql(0);
+  });
+
+  it('keeps long sysex whole', function() {
+    var sysex = Buffer.alloc(1000, 0x55);
+    sysex[0] = 0xf0;
+    sysex[999] = 0xf7;
+    var split = Midi.splitMessages(Buffer.concat([sysex, Buffer.from([0xb0, 7, 64])]));
+    split.lengths.should.eql(new Uint32Array([1000, 3]));
+    split.data.equals(Buffer.concat([sysex, Buffer.from([0xb0, 7, 64])])).should.be.true();
+  });
+
+  it('drops incomplete messages', function() {
+    var split = Midi.splitMessages([5, 6, 0xf0, 1, 2, 0x80, 1, 2, 0xf7, 0x90, 1]);
+    messages(split).should.eql([[0x80, 1, 2]]);
+    split.dropped.should.eql(8);
+  });
+
+  it('counts only the data bytes of a cut off running status message', function() {
+    var split = Midi.splitMessages([0x90, 60, 100, 61, 0xc0, 5, 0x90, 62, 100, 63]);
+    messages(split).should.eql([[0x90, 60, 100], [0xc0, 5], [0x90, 62, 100]]);
+    split.dropped.should.eql(2);
+  });
+});
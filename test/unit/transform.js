@@ -0,0 +1,47 @@
+var should = require('should');
+var Midi = require('../../midi');
+
+describe('midi.compileRules', function() {
+  it('compiles rules to instruction words', function() {
+    var program = Midi.compileRules([{ match: { type: 'noteon' }, forward: true }]);
+    program.code.should.be.an.instanceOf(Uint32Array);
+    program.code.length.should.be.above(0);
+    program.tables.should.eql([]);
+    program.outputs.should.eql([]);
+  });
+
+  it('lists each output once', function() {
+    var output = new Midi.Output();
+    var program = Midi.compileRules([
+      { match: { type: 'cc' }, forward: output },
+      { match: { type: 'noteon' }, send: { type: 'noteoff', to: output } },
+    ]);
+    program.outputs.should.eql([output]);
+  });
+
+  it('turns maps into lookup tables', function() {
+    var program = Midi.compileRules([{ send: { type: 'cc', value: { from: 'data2', map: [0, 10, 20] } } }]);
+    program.tables.should.eql([new Int32Array([0, 10, 20])]);
+  });
+
+  it('rejects unknown types and fields', function() {
+    (function() {
+      Midi.compileRules([{ match: { type: 'notes' } }]);
+    }).should.throw('Unknown message type notes');
+    (function() {
+      Midi.compileRules([{ match: { pitch: 60 } }]);
+    }).should.throw('Unknown message field pitch');
+  });
+
+  it('rejects values which do not fit an instruction', function() {
+    (function() {
+      Midi.compileRules([{ match: { note: 100000 } }]);
+    }).should.throw('100000 does not fit in an instruction');
+  });
+
+  it('cannot send sysex', function() {
+    (function() {
+      Midi.compileRules([{ send: { status: 0xf0 } }]);
+    }).should.throw('Rules cannot send sysex');
+  });
+});